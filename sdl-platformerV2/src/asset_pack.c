@@ -0,0 +1,146 @@
+#include "asset_pack.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static struct {
+    Uint8* data;
+    size_t size;
+    const AssetPackEntry* entries;
+    Uint32 count;
+    char path[PATH_MAX];
+} pack;
+
+void asset_resolve(const char* name, char* path, size_t size) {
+    static char* basePath;
+    if (name[0] != '/' && access(name, F_OK) != 0) {
+        if (!basePath) {
+            basePath = SDL_GetBasePath();
+        }
+        if (basePath) {
+            snprintf(path, size, "%s%s", basePath, name);
+            if (access(path, F_OK) == 0) {
+                return;
+            }
+        }
+    }
+    snprintf(path, size, "%s", name);
+}
+
+static int check_pack(void) {
+    const AssetPackHeader* header = (const AssetPackHeader*)pack.data;
+    if (pack.size < sizeof(*header) || memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0 ||
+        header->version != ASSET_PACK_VERSION || header->size != pack.size ||
+        (pack.size - sizeof(*header)) / sizeof(AssetPackEntry) < header->count) {
+        return 0;
+    }
+    const AssetPackEntry* entries = (const AssetPackEntry*)(header + 1);
+    for (Uint32 i = 0; i < header->count; ++i) {
+        if (entries[i].offset > pack.size || entries[i].size > pack.size - entries[i].offset ||
+            memchr(entries[i].name, '\0', ASSET_NAME_SIZE) == NULL ||
+            (i > 0 && strcmp(entries[i - 1].name, entries[i].name) >= 0)) {
+            return 0;
+        }
+    }
+    pack.entries = entries;
+    pack.count = header->count;
+    return 1;
+}
+
+static int is_newer(const char* name, time_t time) {
+    char path[PATH_MAX];
+    asset_resolve(name, path, sizeof(path));
+    struct stat info;
+    return stat(path, &info) == 0 && info.st_mtime > time;
+}
+
+// The pack wins over the loose files, so an asset edited after "make pack" would be ignored silently
+static void warn_if_outdated(time_t time) {
+    for (Uint32 i = 0; i < pack.count; ++i) {
+        char source[ASSET_NAME_SIZE];
+        snprintf(source, sizeof(source), "%s", pack.entries[i].name);
+        const size_t length = strlen(source);
+        const int compiled = length > 4 && strcmp(source + length - 4, ".lvl") == 0;
+        if (compiled) {
+            strcpy(source + length - 4, ".txt"); // Compiled levels are built from the text next to them
+        }
+        if (is_newer(pack.entries[i].name, time) || (compiled && is_newer(source, time))) {
+            fprintf(stderr, "Asset pack: %s is older than %s, run \"make pack\" or start with --pack off\n",
+                    pack.path, compiled ? source : pack.entries[i].name);
+            return;
+        }
+    }
+}
+
+int asset_pack_open(const char* path) {
+    asset_resolve(path, pack.path, sizeof(pack.path));
+    const int fd = open(pack.path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Asset pack: ");
+        perror(pack.path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Asset pack: mmap");
+        return 0;
+    }
+    pack.data = data;
+    pack.size = info.st_size;
+    if (!check_pack()) {
+        fprintf(stderr, "Asset pack: %s is damaged or of another version\n", pack.path);
+        asset_pack_close();
+        return 0;
+    }
+    printf("Assets from %s (%u files)\n", pack.path, pack.count);
+    warn_if_outdated(info.st_mtime);
+    return 1;
+}
+
+void asset_pack_close(void) {
+    if (pack.data) {
+        munmap(pack.data, pack.size);
+    }
+    memset(&pack, 0, sizeof(pack));
+}
+
+const char* asset_pack_get_path(void) {
+    return pack.data ? pack.path : NULL;
+}
+
+static int compare_entry(const void* name, const void* entry) {
+    return strcmp(name, ((const AssetPackEntry*)entry)->name);
+}
+
+const void* asset_pack_find(const char* name, size_t* size) {
+    if (!pack.data) {
+        return NULL;
+    }
+    const AssetPackEntry* entry = bsearch(name, pack.entries, pack.count, sizeof(AssetPackEntry), compare_entry);
+    if (!entry) {
+        return NULL;
+    }
+    *size = entry->size;
+    return pack.data + entry->offset;
+}
+
+SDL_RWops* asset_open(const char* name) {
+    size_t size;
+    const void* data = asset_pack_find(name, &size);
+    if (data) {
+        return SDL_RWFromConstMem(data, size);
+    }
+    char path[PATH_MAX];
+    asset_resolve(name, path, sizeof(path));
+    return SDL_RWFromFile(path, "rb");
+}
@@ -0,0 +1,52 @@
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include "types.h"
+
+// Asset pack: the files the game loads (sprites, font, sounds, levels) in one
+// file, written by sdl_platformer_pack ("make pack") and mapped at the start.
+// The loaders read an asset straight from the mapping, one open and no copy
+// per file on the SD card. An asset missing in the pack, or every asset
+// without a pack, is read from its file: relative to the working directory if
+// it's there, else relative to the directory of the executable, so the game
+// also starts from outside of src/.
+//
+// Layout, in the byte order of the machine which wrote it:
+//   AssetPackHeader, AssetPackEntry[count] sorted by name, then the data of
+//   every entry ASSET_PACK_ALIGNMENT aligned at the offset of its entry
+
+#define ASSET_PACK_MAGIC "PACK"
+enum {
+    ASSET_PACK_VERSION = 1,
+    ASSET_PACK_ALIGNMENT = 64,
+    ASSET_NAME_SIZE = 56        // With the terminating zero
+};
+
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint32 count;
+    Uint32 size;                // Of the whole pack
+} AssetPackHeader;
+
+typedef struct {
+    char name[ASSET_NAME_SIZE]; // Relative path as the game asks for it, e.g. "image/sprites.bmp"
+    Uint32 offset;
+    Uint32 size;
+} AssetPackEntry;
+
+// Maps the pack, found like a loose asset, and warns if one of its files was
+// changed after it. Returns 0 after printing the reason if it can't be used.
+int asset_pack_open(const char* path);
+void asset_pack_close(void);
+const char* asset_pack_get_path(void); // The mapped pack, NULL if none is open
+
+// Returns the data of the asset in the pack, NULL if it isn't there
+const void* asset_pack_find(const char* name, size_t* size);
+// Writes where the loose file of the asset is, see above. Names which
+// exist nowhere are written as they are.
+void asset_resolve(const char* name, char* path, size_t size);
+// Opens the asset from the pack or from its file, NULL if it exists nowhere
+SDL_RWops* asset_open(const char* name);
+
+#endif /* ASSET_PACK_H */
@@ -0,0 +1,312 @@
+#include "audio.h"
+#include "asset_pack.h"
+#include "rng.h"
+#include "spsc_queue.h"
+#include <SDL2/SDL.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum {
+    MIX_RATE = 48000,       // Hz, the bank is stored at this rate
+    MIX_BUFFER = 512,       // Frames per callback, about 10 ms
+    VOICE_COUNT = 16,
+    COMMAND_QUEUE_SIZE = 64,
+};
+
+static const char* const SOUND_NAMES[SOUND_COUNT] = {
+    "coin", "key", "heart", "killed", "spring", "shot", "level_complete"
+};
+
+// Synthesized replacement of a missing WAV: up to four tones or noise bursts
+typedef enum { WAVE_NONE = 0, WAVE_SINE, WAVE_SQUARE, WAVE_NOISE } Wave;
+typedef struct {
+    Wave wave;
+    float from, to; // Frequency sweep, Hz
+    int ms;
+} Tone;
+static const Tone SYNTHESIZED[SOUND_COUNT][4] = {
+    [SOUND_COIN] = {{WAVE_SQUARE, 988, 988, 60}, {WAVE_SQUARE, 1319, 1319, 200}},
+    [SOUND_KEY] = {{WAVE_SINE, 660, 660, 70}, {WAVE_SINE, 880, 880, 70}, {WAVE_SINE, 1100, 1100, 140}},
+    [SOUND_HEART] = {{WAVE_SINE, 523, 523, 60}, {WAVE_SINE, 659, 659, 60}, {WAVE_SINE, 784, 784, 60}, {WAVE_SINE, 1047, 1047, 200}},
+    [SOUND_KILLED] = {{WAVE_SQUARE, 600, 100, 500}},
+    [SOUND_SPRING] = {{WAVE_SINE, 200, 900, 200}},
+    [SOUND_SHOT] = {{WAVE_NOISE, 0, 0, 120}},
+    [SOUND_LEVEL_COMPLETE] = {{WAVE_SQUARE, 523, 523, 120}, {WAVE_SQUARE, 659, 659, 120}, {WAVE_SQUARE, 784, 784, 120}, {WAVE_SQUARE, 1047, 1047, 500}},
+};
+
+typedef struct {
+    Uint8 sound;
+    Sint16 gain; // Q15
+} AudioCommand;
+
+typedef struct {
+    const Sint16* samples; // NULL if the voice is free
+    int length;
+    int position;
+    Sint16 gain;
+} Voice;
+
+static struct {
+    int initialized;        // The audio subsystem was started by audio_initialize()
+    SDL_AudioDeviceID device;
+    Sint16* bank;           // All sounds, mono at MIX_RATE
+    int offset[SOUND_COUNT];
+    int length[SOUND_COUNT];
+    SpscQueue commands;     // Game thread to audio callback
+    int muted;              // Owned by the game thread
+    // Owned by the audio callback
+    Voice voices[VOICE_COUNT];
+    Sint32 accumulator[MIX_BUFFER];
+} audio = {0};
+
+// acc[i] += src[i] * gain >> 15
+static void mix_kernel(Sint32* acc, const Sint16* src, int n, Sint16 gain) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    const int16x4_t g = vdup_n_s16(gain);
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        vst1q_s32(acc + i, vsraq_n_s32(vld1q_s32(acc + i), vmull_s16(vget_low_s16(s), g), 15));
+        vst1q_s32(acc + i + 4, vsraq_n_s32(vld1q_s32(acc + i + 4), vmull_s16(vget_high_s16(s), g), 15));
+    }
+#elif defined(__SSE2__)
+    const __m128i g = _mm_set1_epi16(gain);
+    for (; i + 8 <= n; i += 8) {
+        const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        const __m128i lo = _mm_mullo_epi16(s, g);
+        const __m128i hi = _mm_mulhi_epi16(s, g);
+        __m128i* a = (__m128i*)(acc + i);
+        _mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15)));
+        _mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15)));
+    }
+#endif
+    for (; i < n; ++i) {
+        acc[i] += (src[i] * gain) >> 15;
+    }
+}
+
+// Saturates the mono mix to 16 bit and writes it to both stereo channels
+static void output_kernel(Sint16* out, const Sint32* acc, int n) {
+    int i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        const int16x4_t v = vqmovn_s32(vld1q_s32(acc + i));
+        vst2_s16(out + 2 * i, (int16x4x2_t){{v, v}});
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v = _mm_packs_epi32(_mm_loadu_si128((const __m128i*)(acc + i)),
+                                          _mm_loadu_si128((const __m128i*)(acc + i + 4)));
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 8), _mm_unpackhi_epi16(v, v));
+    }
+#endif
+    for (; i < n; ++i) {
+        const Sint32 v = acc[i] > 32767 ? 32767 : acc[i] < -32768 ? -32768 : acc[i];
+        out[2 * i] = out[2 * i + 1] = v;
+    }
+}
+
+// Takes a free voice or steals the one which has played longest
+static void start_voice(const AudioCommand* command) {
+    Voice* voice = &audio.voices[0];
+    for (int v = 0; v < VOICE_COUNT; ++v) {
+        if (!audio.voices[v].samples) {
+            voice = &audio.voices[v];
+            break;
+        }
+        if (audio.voices[v].position > voice->position) {
+            voice = &audio.voices[v];
+        }
+    }
+    voice->samples = audio.bank + audio.offset[command->sound];
+    voice->length = audio.length[command->sound];
+    voice->position = 0;
+    voice->gain = command->gain;
+}
+
+static void audio_callback(void* userdata, Uint8* stream, int len) {
+    (void)userdata;
+    AudioCommand command;
+    while (spsc_queue_pop(&audio.commands, &command)) {
+        start_voice(&command);
+    }
+
+    Sint16* out = (Sint16*)stream;
+    int frames = len / (2 * sizeof(Sint16));
+    while (frames > 0) {
+        const int n = frames < MIX_BUFFER ? frames : MIX_BUFFER;
+        memset(audio.accumulator, 0, n * sizeof(Sint32));
+        for (int v = 0; v < VOICE_COUNT; ++v) {
+            Voice* voice = &audio.voices[v];
+            if (!voice->samples) {
+                continue;
+            }
+            const int count = voice->length - voice->position < n ? voice->length - voice->position : n;
+            mix_kernel(audio.accumulator, voice->samples + voice->position, count, voice->gain);
+            voice->position += count;
+            if (voice->position >= voice->length) {
+                voice->samples = NULL;
+            }
+        }
+        output_kernel(out, audio.accumulator, n);
+        out += 2 * n;
+        frames -= n;
+    }
+}
+
+static int synthesized_length(SoundId sound) {
+    int ms = 0;
+    for (int t = 0; t < 4 && SYNTHESIZED[sound][t].wave != WAVE_NONE; ++t) {
+        ms += SYNTHESIZED[sound][t].ms;
+    }
+    return ms * MIX_RATE / 1000;
+}
+
+static void synthesize(SoundId sound, Sint16* out) {
+    Rng rng;
+    rng_seed(&rng, sound, 0);
+    double phase = 0;
+    for (int t = 0; t < 4 && SYNTHESIZED[sound][t].wave != WAVE_NONE; ++t) {
+        const Tone* tone = &SYNTHESIZED[sound][t];
+        const int n = tone->ms * MIX_RATE / 1000;
+        for (int i = 0; i < n; ++i) {
+            const double progress = (double)i / n;
+            const double frequency = tone->from + (tone->to - tone->from) * progress;
+            phase += frequency / MIX_RATE;
+            phase -= floor(phase);
+            double value;
+            if (tone->wave == WAVE_SINE) {
+                value = sin(2 * M_PI * phase);
+            } else if (tone->wave == WAVE_SQUARE) {
+                value = phase < 0.5 ? 0.5 : -0.5;
+            } else {
+                value = (rng_next(&rng) & 0xffff) / 32768.0 - 1;
+            }
+            // Short attack against clicks, then an exponential decay
+            const double envelope = fmin(1.0, i / (0.002 * MIX_RATE)) * exp(-3 * progress);
+            *out++ = value * envelope * 0.4 * 32767;
+        }
+    }
+}
+
+// Decodes a WAV to mono 16 bit at MIX_RATE, returns NULL if it is missing or unusable
+static Sint16* load_wav(const char* path, int* length) {
+    SDL_AudioSpec spec;
+    Uint8* data;
+    Uint32 size;
+    if (!SDL_LoadWAV_RW(asset_open(path), 1, &spec, &data, &size)) {
+        return NULL;
+    }
+    SDL_AudioCVT cvt;
+    Sint16* samples = NULL;
+    if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, AUDIO_S16SYS, 1, MIX_RATE) >= 0) {
+        cvt.len = size;
+        cvt.buf = malloc(size * cvt.len_mult);
+        if (cvt.buf) {
+            memcpy(cvt.buf, data, size);
+            if (SDL_ConvertAudio(&cvt) == 0) {
+                samples = (Sint16*)cvt.buf;
+                *length = cvt.len_cvt / sizeof(Sint16);
+            } else {
+                free(cvt.buf);
+            }
+        }
+    }
+    SDL_FreeWAV(data);
+    return samples;
+}
+
+// Decodes all sounds into one contiguous bank
+static int load_bank(const char* directory) {
+    Sint16* loaded[SOUND_COUNT] = {0};
+    int total = 0;
+    for (int s = 0; s < SOUND_COUNT; ++s) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s.wav", directory, SOUND_NAMES[s]);
+        loaded[s] = load_wav(path, &audio.length[s]);
+        if (!loaded[s]) {
+            audio.length[s] = synthesized_length(s);
+        }
+        audio.offset[s] = total;
+        total += audio.length[s];
+    }
+
+    audio.bank = malloc(sizeof(Sint16) * (total > 0 ? total : 1));
+    for (int s = 0; s < SOUND_COUNT; ++s) {
+        if (loaded[s]) {
+            if (audio.bank) {
+                memcpy(audio.bank + audio.offset[s], loaded[s], sizeof(Sint16) * audio.length[s]);
+            }
+            free(loaded[s]);
+        } else if (audio.bank) {
+            synthesize(s, audio.bank + audio.offset[s]);
+        }
+    }
+    return audio.bank != NULL;
+}
+
+void audio_initialize(const char* directory) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        fprintf(stderr, "Audio unavailable: %s\n", SDL_GetError());
+        return;
+    }
+    audio.initialized = 1;
+    if (!load_bank(directory) || !spsc_queue_init(&audio.commands, sizeof(AudioCommand), COMMAND_QUEUE_SIZE)) {
+        fprintf(stderr, "Audio: out of memory\n");
+        audio_shutdown();
+        return;
+    }
+
+    SDL_AudioSpec wanted, obtained;
+    SDL_zero(wanted);
+    wanted.freq = MIX_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 2;
+    wanted.samples = MIX_BUFFER;
+    wanted.callback = audio_callback;
+    audio.device = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, 0); // SDL converts to the device format
+    if (audio.device == 0) {
+        fprintf(stderr, "Audio unavailable: %s\n", SDL_GetError());
+        audio_shutdown();
+        return;
+    }
+    SDL_PauseAudioDevice(audio.device, 0);
+    printf("Audio: %d Hz, %d frames per callback\n", obtained.freq, obtained.samples);
+}
+
+void audio_shutdown(void) {
+    if (!audio.initialized) {
+        return;
+    }
+    if (audio.device) {
+        SDL_CloseAudioDevice(audio.device); // Waits for a running callback
+        audio.device = 0;
+    }
+    spsc_queue_free(&audio.commands);
+    free(audio.bank);
+    audio.bank = NULL;
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    audio.initialized = 0;
+}
+
+void audio_play(SoundId sound, float volume) {
+    if (!audio.device || audio.muted) {
+        return;
+    }
+    volume = volume < 0 ? 0 : volume > 1 ? 1 : volume;
+    const AudioCommand command = {sound, (Sint16)(volume * 32767)};
+    spsc_queue_push(&audio.commands, &command); // A full queue drops the sound
+}
+
+void audio_set_muted(int muted) {
+    audio.muted = muted;
+}
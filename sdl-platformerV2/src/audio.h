@@ -0,0 +1,29 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+// Sound effects, mixed in the SDL audio callback from a bank decoded at startup
+typedef enum {
+    SOUND_COIN = 0,
+    SOUND_KEY,
+    SOUND_HEART,
+    SOUND_KILLED,
+    SOUND_SPRING,
+    SOUND_SHOT,
+    SOUND_LEVEL_COMPLETE,
+    SOUND_COUNT
+} SoundId;
+
+// Loads <directory>/<name>.wav for every sound, missing files are synthesized.
+// Without an audio device the game runs silently.
+void audio_initialize(const char* directory);
+void audio_shutdown(void);
+
+// Game thread: queues the sound without locking or allocating, volume 0..1.
+// Does nothing if audio isn't initialized, e.g. in the tools.
+void audio_play(SoundId sound, float volume);
+
+// Game thread: audio_play() ignores sounds while muted, e.g. when a rollback
+// simulates ticks again which already played their sounds
+void audio_set_muted(int muted);
+
+#endif /* AUDIO_H */
@@ -0,0 +1,208 @@
+#include "bot.h"
+#include "game.h"
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+enum {
+    LINE_SIZE = 256,
+    POLL_MS = 10    // While the bot thinks, SDL events are pumped this often
+};
+
+static const char* STATE_NAMES[] = {"quit", "playing", "killed", "gameover", "complete"};
+
+static struct {
+    int listener;
+    int connection;         // -1 without a bot
+    FILE* out;
+    char received[LINE_SIZE]; // Start of the next command, the rest of it hasn't arrived yet
+    size_t receivedLength;
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    int input;              // INPUT_* flags held by the bot
+    long steps;             // Ticks left of the current step command
+    unsigned long tick;     // Ticks simulated since the start
+} bot = {-1, -1};
+
+int bot_start(const char* path) {
+    struct sockaddr_un address = {0};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Bot: socket path too long: %s\n", path);
+        return 0;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path); // Left behind by an earlier session
+    signal(SIGPIPE, SIG_IGN); // A bot which disconnects ends the session instead of the process
+
+    bot.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (bot.listener < 0 || bind(bot.listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(bot.listener, 1) != 0) {
+        perror("Bot: socket");
+        return 0;
+    }
+    strcpy(bot.path, path);
+
+    printf("Waiting for a bot on %s\n", path);
+    fflush(stdout);
+    const int s = accept(bot.listener, NULL, NULL);
+    if (s < 0) {
+        perror("Bot: accept");
+        return 0;
+    }
+    bot.out = fdopen(dup(s), "w");
+    if (!bot.out) {
+        perror("Bot: fdopen");
+        close(s);
+        return 0;
+    }
+    bot.connection = s;
+    bot.receivedLength = 0;
+    printf("Bot connected\n");
+    return 1;
+}
+
+static void disconnect(void) {
+    if (bot.connection < 0) {
+        return;
+    }
+    close(bot.connection);
+    fclose(bot.out);
+    bot.connection = -1;
+    bot.out = NULL;
+}
+
+void bot_stop(void) {
+    if (bot.listener < 0) {
+        return;
+    }
+    disconnect();
+    close(bot.listener);
+    unlink(bot.path);
+    bot.listener = -1;
+    printf("Bot: %lu ticks\n", bot.tick);
+}
+
+int bot_is_active(void) {
+    return bot.connection >= 0;
+}
+
+static void send_state(void) {
+    fprintf(bot.out, "state %lu %s %d %d %.2f %.2f %.2f %.2f %d %d %d %d\n", bot.tick, STATE_NAMES[getGameState()],
+            level->r, level->c, player.x, player.y, player.vx, player.vy,
+            player.health, player.lives, player.coins, player.keys);
+}
+
+static void send_objects(void) {
+    int count = 0;
+    for (int i = 0; i < level->objects.count; ++i) {
+        const Object* object = level->objects.array[i];
+        count += object != (Object*)&player && !object->removed;
+    }
+    fprintf(bot.out, "objects %d\n", count);
+    for (int i = 0; i < level->objects.count; ++i) {
+        const Object* object = level->objects.array[i];
+        if (object != (Object*)&player && !object->removed) {
+            fprintf(bot.out, "%d %.2f %.2f %.2f %.2f %d\n", object->type->typeId,
+                    object->x, object->y, object->vx, object->vy, object->state);
+        }
+    }
+}
+
+// Waits for the next command line without blocking the window: a game with a window keeps
+// pumping its events, and closing it ends the wait. Returns 0 if the bot disconnected or the
+// window was closed.
+static int read_line(char line[LINE_SIZE]) {
+    const int windowed = SDL_WasInit(SDL_INIT_VIDEO) != 0;
+    for (;;) {
+        char* end = memchr(bot.received, '\n', bot.receivedLength);
+        if (end || bot.receivedLength == LINE_SIZE - 1) { // A longer line is split
+            const size_t length = end ? (size_t)(end - bot.received) + 1 : bot.receivedLength;
+            memcpy(line, bot.received, length);
+            line[length] = '\0';
+            bot.receivedLength -= length;
+            memmove(bot.received, bot.received + length, bot.receivedLength);
+            return 1;
+        }
+
+        struct pollfd fd = {bot.connection, POLLIN, 0};
+        const int ready = poll(&fd, 1, windowed ? POLL_MS : -1);
+        if (windowed) {
+            SDL_PumpEvents();
+            if (SDL_HasEvent(SDL_QUIT)) {
+                return 0; // Left in the queue for the game loop
+            }
+        }
+        if (ready > 0) {
+            const ssize_t size = read(bot.connection, bot.received + bot.receivedLength,
+                                      LINE_SIZE - 1 - bot.receivedLength);
+            if (size <= 0) {
+                return 0;
+            }
+            bot.receivedLength += size;
+        }
+    }
+}
+
+int bot_wait_for_step(void) {
+    if (bot.connection < 0) {
+        return -1;
+    }
+    if (bot.steps > 0) {
+        return bot.input;
+    }
+
+    char line[LINE_SIZE];
+    while (read_line(line)) {
+        char command[16] = "";
+        long value = 0;
+        const int fields = sscanf(line, "%15s %li", command, &value);
+        if (fields < 1) {
+            continue;
+        }
+        if (strcmp(command, "step") == 0) {
+            bot.steps = fields == 2 ? value : 1;
+            if (bot.steps > 0) {
+                return bot.input;
+            }
+            fprintf(bot.out, "ok %lu\n", bot.tick);
+        } else if (strcmp(command, "input") == 0 && fields == 2) {
+            bot.input = value & (INPUT_LEFT | INPUT_RIGHT | INPUT_UP | INPUT_DOWN | INPUT_SPACE);
+            fprintf(bot.out, "ok\n");
+        } else if (strcmp(command, "state") == 0) {
+            send_state();
+        } else if (strcmp(command, "objects") == 0) {
+            send_objects();
+        } else if (strcmp(command, "quit") == 0) {
+            fprintf(bot.out, "bye\n");
+            fflush(bot.out);
+            break;
+        } else {
+            fprintf(bot.out, "error unknown command %s\n", command);
+        }
+        fflush(bot.out);
+    }
+
+    disconnect();
+    return -1;
+}
+
+void bot_step_done(void) {
+    if (bot.connection < 0) {
+        return;
+    }
+    bot.tick += 1;
+    bot.steps -= 1;
+    if (!isGameRunning()) {
+        bot.steps = 0;
+        fprintf(bot.out, "quit %lu\n", bot.tick);
+        fflush(bot.out);
+    } else if (bot.steps == 0) {
+        fprintf(bot.out, "ok %lu\n", bot.tick);
+        fflush(bot.out);
+    }
+}
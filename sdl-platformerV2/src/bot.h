@@ -0,0 +1,29 @@
+#ifndef BOT_H
+#define BOT_H
+
+// Bot control: an external program drives the game over a UNIX stream socket,
+// one text command per line. The game only advances when the bot asks for a
+// tick, with the buttons the bot holds, so scripted sessions run as fast as
+// the logic allows and are reproducible with the same seed.
+//
+//   input MASK    hold the buttons, INPUT_* flags     -> ok
+//   step [N]      simulate N ticks (default 1)        -> ok TICK, or quit TICK if the game ended
+//   state         -> state TICK STATE ROOM_R ROOM_C X Y VX VY HEALTH LIVES COINS KEYS
+//   objects       -> objects N, then N lines TYPE X Y VX VY STATE (without the player)
+//   quit          -> bye, and the game quits
+//
+// STATE is playing, killed, gameover or complete. Unknown commands are
+// answered with "error MESSAGE".
+
+// Binds the socket and waits for the bot to connect, returns 0 on failure
+int bot_start(const char* path);
+void bot_stop(void);
+int bot_is_active(void);
+
+// Answers queries until the bot asks for a tick, returns its INPUT_* flags,
+// -1 if the bot quit or disconnected or the window was closed. The window
+// keeps receiving its events while the bot thinks.
+int bot_wait_for_step(void);
+void bot_step_done(void); // After the tick, answers the step command once all its ticks are done
+
+#endif /* BOT_H */
@@ -1,11 +1,22 @@
 #include "frame_control.h"
 #include "helpers.h"
 #include <SDL2/SDL.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 typedef long long time_ns; // Nanoseconds
 static const time_ns TIME_UNDEFINED = -1;
+static const double MISSED_DEADLINE_TOLERANCE = 1.0; // ms of lateness before a frame counts as missed
+static const double MIN_SPIN_MARGIN = 0.05; // ms
+static const double MAX_SPIN_MARGIN = 2.0; // ms
+static const double VSYNC_RATE_TOLERANCE = 0.05; // Relative difference at which the reported refresh rate is trusted
+static const double MAX_UNKNOWN_REFRESH_RATE = 250; // Hz, faster presents without a reported rate mean no vsync
+enum { VSYNC_CALIBRATION_FRAMES = 31 };
+static const double WAKE_LATENCY_WEIGHT = 1.0 / 16; // EWMA weight of a new wake-up latency sample
 
 static struct {
     int started;
@@ -13,9 +24,23 @@ static struct {
     time_ns prev_frame_time;
     time_ns elapsed_frame_time;
     time_ns frame_period;
+    time_ns timer_period;
     unsigned long frame_count;
     double max_delta_time;
+    int use_fixed_frame_time;
+    double fixed_frame_time;
     double time_per_ms;
+    PacingMode pacing;
+    double refresh_rate;
+    int vsync_calibrated;
+    int vsync_sample_count;
+    time_ns vsync_samples[VSYNC_CALIBRATION_FRAMES];
+    double wake_latency;           // EWMA of the wake-up latency of the deadline sleeps, ms
+    double wake_latency_deviation; // EWMA of its absolute deviation, ms
+    FrameStats stats;
+    double interval_m2; // Sum of squared deviations from the mean interval (Welford)
+    time_ns stats_interval;
+    time_ns stats_time;
 } frame_controller = {0};
 
 static inline double time_to_ms(time_ns time) {
@@ -26,6 +51,12 @@ static inline time_ns ms_to_time(double ms) {
     return ms * frame_controller.time_per_ms;
 }
 
+static time_ns get_cpu_time() {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * (time_ns)1000000000 + t.tv_nsec;
+}
+
 static time_ns get_current_time() {
     struct timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t);
@@ -39,8 +70,12 @@ void frame_control_start(int fps, double max_delta_time) {
     frame_controller.prev_frame_time = frame_controller.start_time;
     frame_controller.elapsed_frame_time = 0;
     frame_controller.frame_period = fps > 0 ? ms_to_time(1000.0 / fps) : 0;
+    frame_controller.timer_period = frame_controller.frame_period;
     frame_controller.frame_count = 0;
     frame_controller.max_delta_time = max_delta_time;
+    frame_controller.wake_latency = MIN_SPIN_MARGIN;
+    frame_controller.wake_latency_deviation = MIN_SPIN_MARGIN;
+    frame_control_reset_stats();
     frame_controller.started = 1;
 }
 
@@ -48,25 +83,180 @@ void frame_control_stop() {
     if (!frame_controller.started) {
         return;
     }
+    if (frame_controller.stats_interval > 0) {
+        frame_control_print_stats();
+    }
     frame_controller.started = 0; // ensure_ to mark the controller as stopped.
 }
 
-void frame_control_wait_for_next_frame() {
-    const time_ns next_frame_time = frame_controller.prev_frame_time + frame_controller.frame_period;
-    time_ns current_time = get_current_time();
+static void update_stats(time_ns wait_start, time_ns current_time, time_ns next_frame_time) {
+    FrameStats* stats = &frame_controller.stats;
+    stats->work_time += time_to_ms(wait_start - frame_controller.prev_frame_time);
 
-    while (current_time < next_frame_time) {
-        if (next_frame_time - current_time > frame_controller.time_per_ms) {
-            SDL_Delay(1); // Sleep for 1ms to reduce CPU usage
-        } else {
-            // Spin-wait for precise timing
+    const double interval = time_to_ms(current_time - frame_controller.prev_frame_time);
+    stats->frames++;
+    const double delta = interval - stats->mean_interval;
+    stats->mean_interval += delta / stats->frames;
+    frame_controller.interval_m2 += delta * (interval - stats->mean_interval);
+    stats->jitter = stats->frames > 1 ? sqrt(frame_controller.interval_m2 / (stats->frames - 1)) : 0;
+    if (stats->frames == 1 || interval < stats->min_interval) {
+        stats->min_interval = interval;
+    }
+    if (interval > stats->max_interval) {
+        stats->max_interval = interval;
+    }
+    const int bin = (int)interval;
+    stats->histogram[bin < FRAME_HISTOGRAM_BINS ? bin : FRAME_HISTOGRAM_BINS - 1]++;
+
+    const double lateness = time_to_ms(current_time - next_frame_time);
+    if (lateness > MISSED_DEADLINE_TOLERANCE) {
+        stats->missed_deadlines++;
+        stats->missed_time += lateness;
+    }
+    if (lateness > stats->max_lateness) {
+        stats->max_lateness = lateness;
+    }
+}
+
+static void record_sleep(double requested, double slept) {
+    FrameStats* stats = &frame_controller.stats;
+    const double overshoot = slept - requested;
+    stats->sleep_time += slept;
+    stats->sleep_calls++;
+    if (overshoot > 0) {
+        stats->sleep_overshoot += overshoot;
+        if (overshoot > stats->max_sleep_overshoot) {
+            stats->max_sleep_overshoot = overshoot;
         }
+    }
+}
+
+static time_ns spin_until(time_ns deadline, time_ns current_time) {
+    const time_ns spin_start = current_time;
+    while (current_time < deadline) {
         current_time = get_current_time();
     }
+    frame_controller.stats.spin_time += time_to_ms(current_time - spin_start);
+    return current_time;
+}
+
+static time_ns wait_legacy(time_ns next_frame_time, time_ns current_time) {
+    while (next_frame_time - current_time > frame_controller.time_per_ms) {
+        const time_ns before = current_time;
+        SDL_Delay(1); // Sleep for 1ms to reduce CPU usage
+        current_time = get_current_time();
+        record_sleep(1.0, time_to_ms(current_time - before));
+    }
+    return spin_until(next_frame_time, current_time); // Spin-wait for precise timing
+}
+
+// Sleeps until shortly before the deadline and spins the rest. The margin follows the
+// measured wake-up latency, so the spin only covers what the scheduler can't deliver.
+static time_ns wait_sleep(time_ns next_frame_time, time_ns current_time) {
+    const double margin = frame_controller.stats.spin_margin;
+    const time_ns wake_time = next_frame_time - ms_to_time(margin);
+    if (wake_time > current_time) {
+        const time_ns before = current_time;
+        const struct timespec t = {wake_time / 1000000000, wake_time % 1000000000};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+        }
+        current_time = get_current_time();
+        record_sleep(time_to_ms(wake_time - before), time_to_ms(current_time - before));
+
+        const double latency = time_to_ms(current_time - wake_time);
+        frame_controller.wake_latency += WAKE_LATENCY_WEIGHT * (latency - frame_controller.wake_latency);
+        frame_controller.wake_latency_deviation +=
+            WAKE_LATENCY_WEIGHT * (fabs(latency - frame_controller.wake_latency) - frame_controller.wake_latency_deviation);
+    }
+    return spin_until(next_frame_time, current_time);
+}
+
+static int compare_time(const void* a, const void* b) {
+    const time_ns x = *(const time_ns*)a;
+    const time_ns y = *(const time_ns*)b;
+    return (x > y) - (x < y);
+}
+
+// Measures the interval of the first presents. The display's own refresh rate is used if the
+// measurement confirms it, presents which return too fast mean that vsync isn't really active.
+static void calibrate_vsync(time_ns current_time) {
+    if (frame_controller.vsync_calibrated || frame_controller.frame_count == 0) {
+        return;
+    }
+    frame_controller.vsync_samples[frame_controller.vsync_sample_count++] = current_time - frame_controller.prev_frame_time;
+    if (frame_controller.vsync_sample_count < VSYNC_CALIBRATION_FRAMES) {
+        return;
+    }
+    frame_controller.vsync_calibrated = 1;
+    frame_control_reset_stats(); // The calibration frames don't represent the chosen pacing
+
+    qsort(frame_controller.vsync_samples, VSYNC_CALIBRATION_FRAMES, sizeof(time_ns), compare_time);
+    const double median = time_to_ms(frame_controller.vsync_samples[VSYNC_CALIBRATION_FRAMES / 2]);
+    const double measured = median > 0 ? 1000.0 / median : 0;
+    const double reported = frame_controller.refresh_rate;
+    const double max_rate = reported > 0 ? reported * 1.5 : MAX_UNKNOWN_REFRESH_RATE;
+    if (measured == 0 || measured > max_rate) {
+        printf("VSync pacing: presents don't block (%.1f Hz measured), falling back to timer pacing\n", measured);
+        frame_controller.pacing = PACING_SLEEP;
+        frame_controller.frame_period = frame_controller.timer_period;
+        return;
+    }
+
+    const double rate = reported > 0 && fabs(measured - reported) < reported * VSYNC_RATE_TOLERANCE ? reported : measured;
+    frame_controller.frame_period = ms_to_time(1000.0 / rate);
+    printf("VSync pacing at %.2f Hz (measured %.2f Hz, display reports %.0f Hz)\n", rate, measured, reported);
+}
+
+// Rounds the frame time to whole refresh periods, so every frame advances the simulation
+// by exactly the time it is shown for
+static time_ns snap_to_refresh(time_ns frame_time) {
+    const time_ns period = frame_controller.frame_period;
+    const time_ns refreshes = (frame_time + period / 2) / period;
+    return (refreshes > 0 ? refreshes : 1) * period;
+}
+
+static void update_spin_margin() {
+    double margin = frame_controller.wake_latency + 4 * frame_controller.wake_latency_deviation;
+    if (margin < MIN_SPIN_MARGIN) {
+        margin = MIN_SPIN_MARGIN;
+    } else if (margin > MAX_SPIN_MARGIN) {
+        margin = MAX_SPIN_MARGIN;
+    }
+    frame_controller.stats.spin_margin = margin;
+}
+
+void frame_control_wait_for_next_frame() {
+    const time_ns next_frame_time = frame_controller.prev_frame_time + frame_controller.frame_period;
+    const time_ns wait_start = get_current_time();
+    const time_ns cpu_start = get_cpu_time();
+    time_ns current_time;
+
+    if (frame_controller.pacing == PACING_VSYNC) {
+        current_time = wait_start; // SDL_RenderPresent already blocked until the vertical blank
+        calibrate_vsync(current_time);
+    } else if (frame_controller.pacing == PACING_LEGACY) {
+        current_time = wait_legacy(next_frame_time, wait_start);
+    } else {
+        current_time = wait_sleep(next_frame_time, wait_start);
+        update_spin_margin();
+    }
+    frame_controller.stats.wait_cpu_time += time_to_ms(get_cpu_time() - cpu_start);
+
+    if (frame_controller.frame_count > 0) {
+        update_stats(wait_start, current_time, next_frame_time);
+    }
 
     frame_controller.elapsed_frame_time = frame_controller.prev_frame_time ? current_time - frame_controller.prev_frame_time : 0;
+    if (frame_controller.pacing == PACING_VSYNC && frame_controller.vsync_calibrated) {
+        frame_controller.elapsed_frame_time = snap_to_refresh(frame_controller.elapsed_frame_time);
+    }
     frame_controller.prev_frame_time = current_time;
     frame_controller.frame_count++;
+
+    if (frame_controller.stats_interval > 0 && current_time - frame_controller.stats_time >= frame_controller.stats_interval) {
+        frame_control_print_stats();
+        frame_control_reset_stats();
+    }
 }
 
 double frame_control_get_elapsed_time() {
@@ -77,10 +267,89 @@ double frame_control_get_current_fps() {
     return frame_controller.frame_count / (time_to_ms(frame_controller.prev_frame_time - frame_controller.start_time) / 1000.0);
 }
 
+void frame_control_set_fixed_frame_time(double ms) {
+    frame_controller.use_fixed_frame_time = ms >= 0;
+    frame_controller.fixed_frame_time = ms;
+}
+
 double frame_control_get_elapsed_frame_time() {
+    if (frame_controller.use_fixed_frame_time) {
+        return frame_controller.fixed_frame_time;
+    }
     const double elapsed_time = time_to_ms(frame_controller.elapsed_frame_time);
     if (frame_controller.max_delta_time > 0 && elapsed_time > frame_controller.max_delta_time) {
         return frame_controller.max_delta_time;
     }
     return elapsed_time;
 }
+
+void frame_control_get_stats(FrameStats* stats) {
+    *stats = frame_controller.stats;
+}
+
+void frame_control_reset_stats() {
+    memset(&frame_controller.stats, 0, sizeof(frame_controller.stats));
+    frame_controller.interval_m2 = 0;
+    update_spin_margin();
+    frame_controller.stats_time = get_current_time();
+}
+
+void frame_control_set_pacing(PacingMode mode) {
+    frame_controller.pacing = mode;
+    frame_controller.frame_period = frame_controller.timer_period;
+    frame_controller.vsync_calibrated = 0;
+    frame_controller.vsync_sample_count = 0;
+}
+
+PacingMode frame_control_get_pacing() {
+    return frame_controller.pacing;
+}
+
+void frame_control_set_refresh_rate(double hz) {
+    frame_controller.refresh_rate = hz;
+    if (frame_controller.pacing == PACING_VSYNC && hz > 0) {
+        frame_controller.frame_period = ms_to_time(1000.0 / hz);
+    }
+}
+
+void frame_control_set_stats_interval(double seconds) {
+    frame_controller.stats_interval = seconds > 0 ? ms_to_time(seconds * 1000) : 0;
+}
+
+void frame_control_print_stats() {
+    const FrameStats* stats = &frame_controller.stats;
+    if (stats->frames == 0) {
+        return;
+    }
+    const double period = time_to_ms(frame_controller.frame_period);
+    const double total = stats->work_time + stats->sleep_time + stats->spin_time;
+    printf("Frame pacing: %lu frames, interval %.2f ms (target %.2f), jitter %.2f ms, min %.2f ms, max %.2f ms\n",
+           stats->frames, stats->mean_interval, period, stats->jitter, stats->min_interval, stats->max_interval);
+    printf("  missed deadlines: %lu (%.1f%%), %.1f ms late in total, worst %.2f ms\n",
+           stats->missed_deadlines, 100.0 * stats->missed_deadlines / stats->frames, stats->missed_time, stats->max_lateness);
+    if (total > 0) {
+        printf("  work %.1f%%, sleep %.1f%%, spin %.1f%%\n",
+               100 * stats->work_time / total, 100 * stats->sleep_time / total, 100 * stats->spin_time / total);
+    }
+    const double wait_time = stats->sleep_time + stats->spin_time;
+    if (wait_time > 0) {
+        printf("  waiting used %.1f ms CPU of %.1f ms (%.1f%% saved)\n",
+               stats->wait_cpu_time, wait_time, 100 * (1 - stats->wait_cpu_time / wait_time));
+    }
+    if (stats->sleep_calls > 0) {
+        printf("  %s: %lu sleeps, mean overshoot %.3f ms, worst %.3f ms",
+               frame_controller.pacing == PACING_LEGACY ? "SDL_Delay(1)" : "clock_nanosleep",
+               stats->sleep_calls, stats->sleep_overshoot / stats->sleep_calls, stats->max_sleep_overshoot);
+        if (frame_controller.pacing == PACING_SLEEP) {
+            printf(", spin margin %.3f ms", stats->spin_margin);
+        }
+        printf("\n");
+    }
+    printf("  histogram:");
+    for (int i = 0; i < FRAME_HISTOGRAM_BINS; ++i) {
+        if (stats->histogram[i]) {
+            printf(" %d%sms:%lu", i, i == FRAME_HISTOGRAM_BINS - 1 ? "+" : "", stats->histogram[i]);
+        }
+    }
+    printf("\n");
+}
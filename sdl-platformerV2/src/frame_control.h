@@ -1,12 +1,49 @@
 #ifndef FRAME_CONTROL_H
 #define FRAME_CONTROL_H
 
+typedef enum {
+    PACING_SLEEP,   // Absolute deadline sleep, then spin for the learned wake-up latency
+    PACING_LEGACY,  // SDL_Delay(1) until the last millisecond, then spin
+    PACING_VSYNC    // The blocking present paces the frames, the frame time snaps to the refresh period
+} PacingMode;
+
+enum { FRAME_HISTOGRAM_BINS = 64 }; // 1ms wide bins, the last one collects all longer intervals
+
+// Pacing statistics since the start or the last reset, all times in milliseconds
+typedef struct {
+    unsigned long frames;
+    double mean_interval;
+    double jitter;                  // Standard deviation of the frame interval
+    double min_interval;
+    double max_interval;
+    unsigned long missed_deadlines; // Frames which started later than the frame period allows
+    double missed_time;             // Sum of the lateness of the missed frames
+    double max_lateness;
+    double work_time;               // Time between the end of one wait and the start of the next
+    double sleep_time;              // Time spent sleeping
+    double spin_time;               // Time spent busy waiting
+    double wait_cpu_time;           // CPU time used while waiting
+    unsigned long sleep_calls;
+    double sleep_overshoot;         // Sum of the time the sleeps woke up later than requested
+    double max_sleep_overshoot;
+    double spin_margin;             // Current spin margin of PACING_SLEEP
+    unsigned long histogram[FRAME_HISTOGRAM_BINS];
+} FrameStats;
+
 void frame_control_start(int fps, double max_delta_time);
 void frame_control_stop(void);
 void frame_control_wait_for_next_frame(void);
 double frame_control_get_elapsed_frame_time(void); // milliseconds
 double frame_control_get_elapsed_time(void); // milliseconds
 double frame_control_get_current_fps(void);
+void frame_control_set_fixed_frame_time(double ms); // Overrides the measured frame time, negative to disable
+void frame_control_set_pacing(PacingMode mode);
+PacingMode frame_control_get_pacing(void); // Changes from PACING_VSYNC to PACING_SLEEP if the presents don't block
+void frame_control_set_refresh_rate(double hz); // Refresh rate reported by the display, 0 if unknown
+void frame_control_get_stats(FrameStats* stats);
+void frame_control_reset_stats(void);
+void frame_control_print_stats(void);
+void frame_control_set_stats_interval(double seconds); // Print and reset the statistics periodically, 0 to disable
 
 #endif /* FRAME_CONTROL_H */
 
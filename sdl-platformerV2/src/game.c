@@ -16,10 +16,29 @@
 #include "levels.h"
 #include "helpers.h"
 #include "objects.h"
-#include "gpio_control.h"
+#include "input.h"
+#include "options.h"
+#include "replay.h"
+#include "profiler.h"
+#include "latency.h"
+#include "audio.h"
+#include "haptics.h"
+#include "net.h"
+#include "snapshot.h"
+#include "spectator.h"
+#include "telemetry.h"
+#include "bot.h"
+#include "level_watch.h"
+#include "rewind.h"
+#include "asset_pack.h"
+#include "level_format.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
 
 
 // ///{
@@ -28,15 +47,6 @@
 //     int rightPressed = readGPIOPin(GPIO_BUTTON_RIGHT);
 //     int upPressed = readGPIOPin(GPIO_BUTTON_UP);
 
-typedef enum
-{
-    STATE_QUIT = 0,
-    STATE_PLAYING,
-    STATE_KILLED,
-    STATE_GAMEOVER,
-    STATE_LEVELCOMPLETE
-} GAME_STATE;
-
 static struct
 {
     GAME_STATE state;
@@ -47,11 +57,41 @@ static struct
     } respawnPos;
     double cleanTime;
     int jumpDenied;
+    Snapshot quickSave; // F5 saves, F9 loads
+    int rewinding;      // Up is held since a death, see processRewind()
+    double startTime;   // Microseconds, until the first frame is presented
 } game;
 
 Level *level = 0;
 Player player;
 
+// Versus mode: every player has its own context, which is copied into the
+// globals above (and the player part of game) while the logic works on it
+typedef struct
+{
+    Player player;
+    Level *level;
+    GAME_STATE state;
+    struct
+    {
+        double x, y;
+    } respawnPos;
+    int jumpDenied;
+} PlayerSlot;
+
+static struct
+{
+    PlayerSlot slots[NET_PLAYER_COUNT];
+    int local;                                  // Slot of the player on this side
+    int tick;                                   // Next tick to simulate
+    int checkedTick;                            // Newest tick whose checksum went to the net module
+    Snapshot snapshots[NET_MAX_ROLLBACK + 1];   // State before each of the recent ticks
+    Uint32 checksums[NET_MAX_ROLLBACK + 1];     // State after each of the recent ticks
+    int resimulating;
+} versus;
+
+static const SDL_Color REMOTE_PLAYER_COLOR = {255, 160, 160, 255};
+
 
 //fast debug: 
 void printPlayerOnLadderStatus(const Player* player) {
@@ -75,12 +115,10 @@ static const double PLAYER_ANIM_SPEED_RUN = 8;    // Frames per second
 static const double PLAYER_ANIM_SPEED_LADDER = 6; //
 
 static const double CLEAN_PERIOD = 10000; // Milliseconds
+static const int CLEAN_TICKS = CLEAN_PERIOD * FRAME_RATE / 1000; // In versus mode, which has a fixed frame time
 
-//flags for handeling button input to create continius movement:
-static int movingLeft = 0;
-static int movingRight = 0;
-static int movingUp = 0;
-static int movingDown = 0;
+// Buttons held, as INPUT_* flags, to create continuous movement
+static Uint8 buttonsHeld = 0;
 
 void damagePlayer(int damage)
 {
@@ -94,6 +132,10 @@ void damagePlayer(int damage)
         player.health = 0;
         killPlayer();
     }
+    else
+    {
+        haptics_play(HAPTIC_DAMAGE);
+    }
 }
 
 void killPlayer()
@@ -103,6 +145,8 @@ void killPlayer()
         return;
     }
     setAnimation((Object *)&player, 5, 5, 0);
+    audio_play(SOUND_KILLED, 1.0f);
+    haptics_play(HAPTIC_KILLED);
     if (--player.lives)
     {
         game.state = STATE_KILLED;
@@ -125,7 +169,7 @@ void respawnPlayer()
 
 void setLevel(int r, int c)
 {
-    level = &levels[r][c];
+    level = getLevel(r, c);
     if (level->initialize)
     {
         level->initialize();
@@ -135,6 +179,7 @@ void setLevel(int r, int c)
 void completeLevel()
 {
     game.state = STATE_LEVELCOMPLETE;
+    audio_play(SOUND_LEVEL_COMPLETE, 1.0f);
 }
 
 void movePlayerLeft()
@@ -240,8 +285,91 @@ void handleNoDirection()
     player.vx = 0;
 }
 
-// Procces Input with buttons:
-static void processInput() {
+// The part of the game struct which is simulation state, the keyboard state is SDL's
+typedef struct
+{
+    GAME_STATE state;
+    double respawnX;
+    double respawnY;
+    double cleanTime;
+    int jumpDenied;
+    int levelSlot; // Index of the current level in world.rooms
+} SavedGame;
+
+void saveGame(Snapshot *snapshot)
+{
+    SavedGame saved;
+    memset(&saved, 0, sizeof(saved)); // The padding goes into the snapshot, rewind deltas compare it
+    saved.state = game.state;
+    saved.respawnX = game.respawnPos.x;
+    saved.respawnY = game.respawnPos.y;
+    saved.cleanTime = game.cleanTime;
+    saved.jumpDenied = game.jumpDenied;
+    saved.levelSlot = level - world.rooms;
+    snapshot_write(snapshot, &saved, sizeof(saved));
+    snapshot_write_player(snapshot, &player);
+    snapshot_write_world(snapshot);
+}
+
+void loadGame(const Snapshot *snapshot)
+{
+    size_t offset = 0;
+    SavedGame saved;
+    snapshot_read(snapshot, &offset, &saved, sizeof(saved));
+    snapshot_read_player(snapshot, &offset, &player);
+    snapshot_read_world(snapshot, &offset);
+    game.state = saved.state;
+    game.respawnPos.x = saved.respawnX;
+    game.respawnPos.y = saved.respawnY;
+    game.cleanTime = saved.cleanTime;
+    game.jumpDenied = saved.jumpDenied;
+    level = &world.rooms[saved.levelSlot];
+    if (level->initialize)
+    {
+        level->initialize();
+    }
+}
+
+static double getTimeMicroseconds()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+// A quick save outside of the input would make recordings, replays, bots and
+// versus matches diverge, so it's only for the normal game
+static int isQuickSaveAllowed()
+{
+    return !replay_is_recording() && !replay_is_playing() && !net_is_active() && !bot_is_active();
+}
+
+static void quickSave()
+{
+    if (!isQuickSaveAllowed() || game.state == STATE_QUIT)
+    {
+        return;
+    }
+    const double start = getTimeMicroseconds();
+    snapshot_clear(&game.quickSave);
+    saveGame(&game.quickSave);
+    printf("Quick save: %zu bytes in %.0f us\n", game.quickSave.size, getTimeMicroseconds() - start);
+}
+
+static void quickLoad()
+{
+    if (!isQuickSaveAllowed() || game.state == STATE_QUIT || game.quickSave.size == 0)
+    {
+        return;
+    }
+    const double start = getTimeMicroseconds();
+    loadGame(&game.quickSave);
+    rewind_reset();
+    printf("Quick load: %.0f us\n", getTimeMicroseconds() - start);
+}
+
+// Reads all pending events and button edges and returns the buttons currently held as INPUT_* flags
+static Uint8 readInput() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
@@ -249,54 +377,60 @@ static void processInput() {
                 game.state = STATE_QUIT;
                 break;
 
-            // Handle button press events
-            case BUTTON_LEFT_PRESSED:
-                movingLeft = 1;
-                break;
-            case BUTTON_RIGHT_PRESSED:
-                movingRight = 1;
-                break;
-            case BUTTON_UP_PRESSED:
-                movingUp = 1;
-                break;
-            case BUTTON_DOWN_PRESSED:
-                movingDown = 1;
-                break;
-
-            // Handle button release events
-            case BUTTON_LEFT_RELEASED:
-                movingLeft = 0;
-                break;
-            case BUTTON_RIGHT_RELEASED:
-                movingRight = 0;
-                break;
-            case BUTTON_UP_RELEASED:
-                movingUp = 0;
-                break;
-            case BUTTON_DOWN_RELEASED:
-                movingDown = 0;
+            case SDL_KEYDOWN:
+                if (event.key.keysym.scancode == SDL_SCANCODE_F3 && !event.key.repeat) {
+                    profiler_toggle_overlay();
+                } else if (event.key.keysym.scancode == SDL_SCANCODE_F5 && !event.key.repeat) {
+                    quickSave();
+                } else if (event.key.keysym.scancode == SDL_SCANCODE_F9 && !event.key.repeat) {
+                    quickLoad();
+                }
                 break;
+        }
+        input_handle_event(&event);
+    }
 
-            // Additional cases for other buttons as necessary
+    // A press and release between two frames still counts as held for one frame
+    Uint8 buttonsPressed = 0;
+    ButtonEvent buttonEvent;
+    while (input_pop_event(&buttonEvent)) {
+        const Uint8 flag = 1 << buttonEvent.button;
+        if (buttonEvent.pressed) {
+            buttonsHeld |= flag;
+            buttonsPressed |= flag;
+        } else {
+            buttonsHeld &= ~flag;
         }
+        latency_mark_input_at(buttonEvent.time);
+    }
+    latency_input_consumed();
+
+    Uint8 input = buttonsHeld | buttonsPressed;
+    // The space key works next to every backend, e.g. with the GPIO buttons
+    if (game.keystate[SDL_SCANCODE_SPACE]) {
+        input |= INPUT_SPACE;
     }
+    return input;
+}
 
+// Procces Input with buttons:
+static void processInput(Uint8 input) {
     // Apply continuous movement based on the state flags
-    if (movingLeft) {
+    if (input & INPUT_LEFT) {
         movePlayerLeft();
     }
-    if (movingRight) {
+    if (input & INPUT_RIGHT) {
         movePlayerRight();
     }
-    if (movingUp) {
+    if (input & INPUT_UP) {
         movePlayerUp();
     }
-    if (movingDown) {
+    if (input & INPUT_DOWN) {
         movePlayerDown();
     }
 
     // Call handleNoDirection() only if no direction is being pressed
-    if (!movingLeft && !movingRight && !movingUp && !movingDown) {
+    if (!(input & (INPUT_LEFT | INPUT_RIGHT | INPUT_UP | INPUT_DOWN))) {
         handleNoDirection();
     }
 }
@@ -500,7 +634,7 @@ static void processPlayer()
     // ... Left
     if (player.x < 0)
     {
-        if (lc > 0 && !levels[lr][lc - 1].cells[r][COLUMN_COUNT - 1]->solid)
+        if (lc > 0 && !getLevel(lr, lc - 1)->cells[r][COLUMN_COUNT - 1]->solid)
         {
             if (player.x + CELL_HALF < 0)
             {
@@ -516,7 +650,7 @@ static void processPlayer()
     }
     else if (player.x + CELL_SIZE > LEVEL_WIDTH)
     {
-        if (lc < LEVEL_COUNTX - 1 && !levels[lr][lc + 1].cells[r][0]->solid)
+        if (lc < levelCountX - 1 && !getLevel(lr, lc + 1)->cells[r][0]->solid)
         {
             if (player.x + CELL_HALF > LEVEL_WIDTH)
             {
@@ -532,9 +666,9 @@ static void processPlayer()
     // ... Bottom
     if (player.y + player.type->body.h > LEVEL_HEIGHT)
     {
-        if (lr < LEVEL_COUNTY - 1)
+        if (lr < levelCountY - 1)
         {
-            if (!levels[lr + 1][lc].cells[0][c]->solid)
+            if (!getLevel(lr + 1, lc)->cells[0][c]->solid)
             {
                 if (player.y + player.type->body.h / 2 > LEVEL_HEIGHT)
                 {
@@ -556,7 +690,7 @@ static void processPlayer()
     }
     else if (player.y < 0)
     {
-        if (lr > 0 && !levels[lr - 1][lc].cells[ROW_COUNT - 1][c]->solid)
+        if (lr > 0 && !getLevel(lr - 1, lc)->cells[ROW_COUNT - 1][c]->solid)
         {
             if (player.y + CELL_HALF < 0)
             {
@@ -641,120 +775,669 @@ static void processObjects()
     }
 }
 
-static void processFrame()
+// Advances the current player by one frame, without the objects
+static void processPlayerState(Uint8 input)
 {
-    // Draw screen
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-
-    drawScreen();
-
-    if (game.state == STATE_KILLED)
+    if (game.state == STATE_PLAYING)
     {
-        drawMessage(MESSAGE_PLAYER_KILLED);
+        PROFILE(PHASE_INPUT) processInput(input);
+        PROFILE(PHASE_PLAYER) processPlayer();
+    }
+    else if (game.state == STATE_KILLED)
+    {
+        if (input & INPUT_SPACE)
+        {
+            game.state = STATE_PLAYING;
+            respawnPlayer();
+        }
     }
     else if (game.state == STATE_LEVELCOMPLETE)
     {
-        drawMessage(MESSAGE_LEVEL_COMPLETE);
+        // ... Space
+        if (input & INPUT_SPACE)
+        {
+            game.state = STATE_QUIT;
+        }
     }
     else if (game.state == STATE_GAMEOVER)
     {
-        drawMessage(MESSAGE_GAME_OVER);
+        // ... Space
+        if (input & INPUT_SPACE)
+        {
+            game.state = STATE_QUIT;
+        }
     }
+}
+
+// Holding up after a death goes back in time by one tick per frame, releasing
+// it plays on from there. Returns 1 if the tick was spent rewinding.
+static int processRewind(Uint8 input)
+{
+    if (!rewind_is_enabled() || !(input & INPUT_UP) || (game.state != STATE_KILLED && !game.rewinding))
+    {
+        game.rewinding = 0;
+        return 0;
+    }
+    game.rewinding = 1;
+    rewind_step_back(); // At the oldest tick the game stays there
+    return 1;
+}
+
+// Advances the game logic by one frame with the given INPUT_* flags
+void processTick(Uint8 input)
+{
+    if (processRewind(input))
+    {
+        return;
+    }
+    const double current_time = frame_control_get_elapsed_time();
 
-    SDL_RenderPresent(renderer);
+    const int playing = game.state == STATE_PLAYING;
+    processPlayerState(input);
+    if (playing)
+    {
+        PROFILE(PHASE_OBJECTS) processObjects();
+    }
 
-    // Read all events
-    // SDL_Event event;
-    // while (SDL_PollEvent(&event))
-    // {
-    //     switch (event.type)
-    //     {
-    //     case SDL_QUIT:
-    //         game.state = STATE_QUIT;
-    //         break;
+    // Delete unused objects from memory
+    if (current_time >= game.cleanTime)
+    {
+        game.cleanTime = current_time + CLEAN_PERIOD;
+        PROFILE(PHASE_CLEAN) ObjectArray_clean(&level->objects);
+    }
+    if (game.state == STATE_PLAYING)
+    {
+        rewind_record();
+    }
+}
 
-        
-    //     }
-    // }
+// Checksum of everything the game logic depends on, used to detect replay divergence.
+// Removed objects are skipped, so it does not depend on when they are cleaned up.
+static Uint32 computeStateChecksum(Uint32 hash)
+{
+    hash = hash_bytes(&game.state, sizeof(game.state), hash);
+    hash = hash_bytes(&level->r, sizeof(level->r), hash);
+    hash = hash_bytes(&level->c, sizeof(level->c), hash);
+    hash = hash_bytes(&player.x, sizeof(player.x), hash);
+    hash = hash_bytes(&player.y, sizeof(player.y), hash);
+    hash = hash_bytes(&player.vx, sizeof(player.vx), hash);
+    hash = hash_bytes(&player.vy, sizeof(player.vy), hash);
+    hash = hash_bytes(&player.inAir, sizeof(player.inAir), hash);
+    hash = hash_bytes(&player.onLadder, sizeof(player.onLadder), hash);
+    hash = hash_bytes(&player.health, sizeof(player.health), hash);
+    hash = hash_bytes(&player.invincibility, sizeof(player.invincibility), hash);
+    hash = hash_bytes(&player.lives, sizeof(player.lives), hash);
+    hash = hash_bytes(&player.coins, sizeof(player.coins), hash);
+    hash = hash_bytes(&player.keys, sizeof(player.keys), hash);
 
-    // Additional input processing logic can be placed here, if necessary
-    // For example, handling continuous actions or updating game state based on input
+    for (int i = 0; i < level->objects.count; ++i)
+    {
+        const Object *object = level->objects.array[i];
+        if (object == (Object *)&player || object->removed)
+        {
+            continue;
+        }
+        hash = hash_bytes(&object->type->typeId, sizeof(object->type->typeId), hash);
+        hash = hash_bytes(&object->x, sizeof(object->x), hash);
+        hash = hash_bytes(&object->y, sizeof(object->y), hash);
+        hash = hash_bytes(&object->vx, sizeof(object->vx), hash);
+        hash = hash_bytes(&object->vy, sizeof(object->vy), hash);
+        hash = hash_bytes(&object->state, sizeof(object->state), hash);
+        hash = hash_bytes(&object->data, sizeof(object->data), hash);
+        hash = hash_bytes(&object->rng, sizeof(object->rng), hash);
+    }
+    return hash;
+}
 
+static void loadSlot(int i)
+{
+    const PlayerSlot *slot = &versus.slots[i];
+    player = slot->player;
+    level = getLevel(slot->level->r, slot->level->c); // Used every tick, so the room of neither player is evicted
+    game.state = slot->state;
+    game.respawnPos.x = slot->respawnPos.x;
+    game.respawnPos.y = slot->respawnPos.y;
+    game.jumpDenied = slot->jumpDenied;
+}
 
-// Process user input and game logic
-const double current_time =frame_control_get_elapsed_time();
+static void storeSlot(int i)
+{
+    PlayerSlot *slot = &versus.slots[i];
+    slot->player = player;
+    slot->level = level;
+    slot->state = game.state;
+    slot->respawnPos.x = game.respawnPos.x;
+    slot->respawnPos.y = game.respawnPos.y;
+    slot->jumpDenied = game.jumpDenied;
+}
 
-if (game.state == STATE_PLAYING)
+// Sounds and vibration only for what happens to the local player, and only once
+static void muteEffects(int muted)
 {
-    processInput();
-    processPlayer();
-    processObjects();
+    audio_set_muted(muted || versus.resimulating);
+    haptics_set_muted(muted || versus.resimulating);
 }
-else if (game.state == STATE_KILLED)
+
+// The same order on both sides: the players by slot, then every room with a
+// playing player once. Its objects move while the first player in it is
+// loaded, then they are hit tested against each player in the room.
+static void processVersusTick(const Uint8 inputs[NET_PLAYER_COUNT])
 {
-    if (game.keystate[SDL_SCANCODE_SPACE])
+    int playing[NET_PLAYER_COUNT];
+    for (int i = 0; i < NET_PLAYER_COUNT; ++i)
     {
-        game.state = STATE_PLAYING;
-        respawnPlayer();
+        loadSlot(i);
+        muteEffects(i != versus.local);
+        playing[i] = game.state == STATE_PLAYING;
+        processPlayerState(inputs[i]);
+        storeSlot(i);
+    }
+
+    for (int i = 0; i < NET_PLAYER_COUNT; ++i)
+    {
+        Level *room = versus.slots[i].level;
+        int first = playing[i];
+        for (int j = 0; j < i && first; ++j)
+        {
+            first = !(playing[j] && versus.slots[j].level == room);
+        }
+        if (!first)
+        {
+            continue;
+        }
+
+        loadSlot(i);
+        muteEffects(versus.slots[versus.local].level != room);
+        for (int k = 0; k < room->objects.count; ++k)
+        {
+            Object *object = room->objects.array[k];
+            if (object != (Object *)&player && !object->removed)
+            {
+                object->type->onFrame(object);
+            }
+        }
+        storeSlot(i);
+
+        for (int j = i; j < NET_PLAYER_COUNT; ++j)
+        {
+            if (!playing[j] || versus.slots[j].level != room)
+            {
+                continue;
+            }
+            loadSlot(j);
+            muteEffects(j != versus.local);
+            for (int k = 0; k < room->objects.count; ++k)
+            {
+                Object *object = room->objects.array[k];
+                if (object != (Object *)&player && !object->removed && objects_hit_test(object, (Object *)&player))
+                {
+                    object->type->onHit(object);
+                }
+            }
+            storeSlot(j);
+        }
+    }
+    muteEffects(0);
+
+    // The first player to complete the level wins
+    for (int i = 0; i < NET_PLAYER_COUNT; ++i)
+    {
+        if (versus.slots[i].state != STATE_LEVELCOMPLETE)
+        {
+            continue;
+        }
+        for (int j = 0; j < NET_PLAYER_COUNT; ++j)
+        {
+            if (versus.slots[j].state == STATE_PLAYING || versus.slots[j].state == STATE_KILLED)
+            {
+                versus.slots[j].state = STATE_GAMEOVER;
+            }
+        }
+    }
+
+    if (versus.tick % CLEAN_TICKS == 0)
+    {
+        for (int i = 0; i < NET_PLAYER_COUNT; ++i)
+        {
+            ObjectArray_clean(&versus.slots[i].level->objects);
+        }
     }
 }
-else if (game.state == STATE_LEVELCOMPLETE)
+
+static Uint32 computeVersusChecksum()
 {
-    // ... Space
-    if (game.keystate[SDL_SCANCODE_SPACE])
+    Uint32 hash = HASH_INITIAL;
+    for (int i = 0; i < NET_PLAYER_COUNT; ++i)
     {
+        loadSlot(i);
+        hash = computeStateChecksum(hash);
+    }
+    return hash;
+}
+
+static void simulateVersusTick()
+{
+    const int i = versus.tick % (NET_MAX_ROLLBACK + 1);
+    Snapshot *snapshot = &versus.snapshots[i];
+    snapshot_clear(snapshot);
+    snapshot_write(snapshot, versus.slots, sizeof(versus.slots));
+    snapshot_write_world(snapshot);
+
+    Uint8 inputs[NET_PLAYER_COUNT];
+    for (int slot = 0; slot < NET_PLAYER_COUNT; ++slot)
+    {
+        inputs[slot] = net_get_input(slot, versus.tick);
+    }
+    processVersusTick(inputs);
+    versus.checksums[i] = computeVersusChecksum();
+    versus.tick += 1;
+}
+
+// Goes back to the state before the tick and simulates up to the present again
+static void rollbackVersus(int tick)
+{
+    const int present = versus.tick;
+    const Snapshot *snapshot = &versus.snapshots[tick % (NET_MAX_ROLLBACK + 1)];
+    size_t offset = 0;
+    snapshot_read(snapshot, &offset, versus.slots, sizeof(versus.slots));
+    snapshot_read_world(snapshot, &offset);
+
+    versus.resimulating = 1;
+    for (versus.tick = tick; versus.tick < present;)
+    {
+        simulateVersusTick();
+    }
+    versus.resimulating = 0;
+    net_count_rollback(present - tick);
+}
+
+// Ticks simulated without a misprediction keep the checksum they got back then
+static void recordConfirmedChecksums()
+{
+    const int confirmed = SDL_min(net_get_confirmed_tick(), versus.tick - 1);
+    while (versus.checkedTick < confirmed)
+    {
+        versus.checkedTick += 1;
+        net_record_checksum(versus.checkedTick, versus.checksums[versus.checkedTick % (NET_MAX_ROLLBACK + 1)]);
+    }
+}
+
+void initializeVersus()
+{
+    versus.local = net_get_local_slot();
+    versus.tick = 0;
+    versus.checkedTick = -1;
+    game.state = STATE_PLAYING;
+    game.respawnPos.x = player.x;
+    game.respawnPos.y = player.y;
+    game.jumpDenied = 0;
+    for (int i = 0; i < NET_PLAYER_COUNT; ++i)
+    {
+        storeSlot(i);
+    }
+    for (int i = 0; i <= NET_MAX_ROLLBACK; ++i)
+    {
+        snapshot_initialize(&versus.snapshots[i]);
+    }
+    frame_control_set_fixed_frame_time(1000.0 / FRAME_RATE); // Both sides must simulate the same ticks
+}
+
+int processVersusFrame(Uint8 input)
+{
+    int simulated = 0;
+    storeSlot(versus.local); // Keeps what rendering changed, e.g. the animation
+
+    net_poll();
+    const int rollback = net_take_rollback_tick();
+    if (rollback >= 0)
+    {
+        rollbackVersus(rollback);
+    }
+    recordConfirmedChecksums();
+
+    // The input of a tick is fixed once sent, a frame which waited for the peer keeps it
+    if (!net_has_local_input(versus.tick + options.net_delay))
+    {
+        net_set_local_input(versus.tick + options.net_delay, input);
+    }
+    if (versus.tick - net_get_confirmed_tick() > NET_MAX_ROLLBACK || net_should_wait(versus.tick))
+    {
+        net_count_stall();
+    }
+    else
+    {
+        simulateVersusTick();
+        recordConfirmedChecksums();
+        simulated = 1;
+    }
+    net_send(versus.tick);
+
+    loadSlot(versus.local);
+    if (net_peer_left())
+    {
+        printf("The other player left\n");
         game.state = STATE_QUIT;
     }
+    return simulated;
 }
-else if (game.state == STATE_GAMEOVER)
+
+int getVersusTick()
 {
-    // ... Space
-    if (game.keystate[SDL_SCANCODE_SPACE])
+    return versus.tick;
+}
+
+// Message shown over the level in the current state, MESSAGE_COUNT for none
+static MessageId getStateMessage()
+{
+    switch (game.state)
+    {
+        case STATE_KILLED:
+            return MESSAGE_PLAYER_KILLED;
+        case STATE_LEVELCOMPLETE:
+            return MESSAGE_LEVEL_COMPLETE;
+        case STATE_GAMEOVER:
+            return MESSAGE_GAME_OVER;
+        default:
+            return MESSAGE_COUNT;
+    }
+}
+
+static void renderFrame()
+{
+    resetDrawCallCount();
+
+    // Draw screen
+    PROFILE(PHASE_DRAW)
+    {
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+
+        drawScreen();
+        if (net_is_active())
+        {
+            Player *remote = &versus.slots[!versus.local].player;
+            if (versus.slots[!versus.local].level == level)
+            {
+                animateObject((Object *)remote);
+                drawObjectTinted((Object *)remote, REMOTE_PLAYER_COLOR);
+            }
+        }
+    }
+
+    PROFILE(PHASE_MESSAGE)
+    {
+        const MessageId message = getStateMessage();
+        if (message != MESSAGE_COUNT)
+        {
+            drawMessage(message);
+        }
+
+        if (profiler_is_overlay_visible())
+        {
+            profiler_draw_overlay();
+        }
+    }
+
+    PROFILE(PHASE_PRESENT) SDL_RenderPresent(renderer);
+    latency_presented();
+
+    if (game.startTime > 0)
+    {
+        printf("Time to first frame: %.1f ms (%s start)\n", (getTimeMicroseconds() - game.startTime) / 1000,
+               wasRenderCacheUsed() ? "warm" : "cold");
+        game.startTime = 0;
+    }
+}
+
+static void simulateFrame()
+{
+    Uint8 input;
+    PROFILE(PHASE_INPUT) input = readInput();
+    if (game.state == STATE_QUIT)
+    {
+        return; // Window closed, this frame is neither simulated nor recorded
+    }
+    if (net_is_active())
+    {
+        if (processVersusFrame(input))
+        {
+            spectator_publish(getStateMessage());
+        }
+        latency_simulated();
+        return;
+    }
+    if (bot_is_active())
+    {
+        const int botInput = bot_wait_for_step();
+        if (botInput < 0)
+        {
+            game.state = STATE_QUIT;
+            return;
+        }
+        input = botInput;
+    }
+    else if (replay_is_playing())
+    {
+        double frameTime;
+        if (!replay_next_frame(&input, &frameTime))
+        {
+            game.state = STATE_QUIT;
+            return;
+        }
+        frame_control_set_fixed_frame_time(frameTime);
+    }
+
+    processTick(input);
+    latency_simulated();
+    spectator_publish(getStateMessage());
+
+    if (replay_is_recording())
+    {
+        replay_record_frame(input, frame_control_get_elapsed_frame_time(), computeStateChecksum(HASH_INITIAL));
+    }
+    else if (replay_is_playing() && !replay_verify_frame(computeStateChecksum(HASH_INITIAL)))
     {
         game.state = STATE_QUIT;
     }
+    bot_step_done();
 }
 
-// Delete unused objects from memory
-if (current_time >= game.cleanTime)
+// Shows the state of the previous frame, then simulates the next one
+static void processFrame()
 {
-    game.cleanTime = current_time + CLEAN_PERIOD;
-    ObjectArray_clean(&level->objects);
+    renderFrame();
+    simulateFrame();
 }
+
+// Reads the input as late as possible and presents its result right away
+static void processFrameLowLatency()
+{
+    simulateFrame();
+    if (game.state != STATE_QUIT)
+    {
+        renderFrame();
+    }
 }
 
 static void handelExit()
 {
-   frame_control_stop();
+    input_shutdown();
+    haptics_shutdown();
+    audio_shutdown();
+    spectator_stop();
+    telemetry_stop();
+    bot_stop();
+    level_watch_stop();
+    rewind_stop();
+    replay_stop();
+    if (net_is_active())
+    {
+        net_print_stats();
+        net_shutdown();
+    }
+    frame_control_stop();
+    snapshot_free(&game.quickSave);
+    if (options.profile_csv_path)
+    {
+        profiler_write_csv(options.profile_csv_path);
+    }
+    if (options.latency)
+    {
+        latency_print_stats();
+    }
 
     TTF_Quit();
     SDL_Quit();
+    asset_pack_close();
 }
 
 void initializeGame()
 {
+    game.startTime = getTimeMicroseconds();
     atexit(handelExit);
-    initializeRender("image/sprites.bmp", "font/PressStart2P.ttf");
+    if (options.replay_path)
+    {
+        replay_start_playback(options.replay_path, &options.seed);
+    }
+    else if (options.record_path)
+    {
+        replay_start_recording(options.record_path, options.seed);
+    }
+    if (options.asset_pack)
+    {
+        char path[PATH_MAX];
+        asset_resolve(options.asset_pack, path, sizeof(path));
+        // Edited levels are loose files, the default pack would hide them from --watch-level
+        if (options.asset_pack_required || (!options.watch_level && access(path, F_OK) == 0))
+        {
+            ensure_condition(asset_pack_open(options.asset_pack), "initializeGame(): Can't load the asset pack");
+        }
+    }
+    net_set_packet_loss(options.net_loss);
+    if (options.net_host_port)
+    {
+        ensure_condition(net_host(options.net_host_port, &options.seed), "initializeGame(): Nobody joined the versus match");
+    }
+    else if (options.net_join_address)
+    {
+        ensure_condition(net_join(options.net_join_address, &options.seed), "initializeGame(): Can't join the versus match");
+    }
+    printf("Random seed: %u\n", options.seed);
+    initializeRender("image/sprites.bmp", "font/PressStart2P.ttf", options.render_cache, options.pacing == PACING_VSYNC);
+    initializeSimulation();
+    if (net_is_active())
+    {
+        initializeVersus();
+    }
+    input_initialize(options.input);
+    if (options.haptics)
+    {
+        haptics_initialize(options.haptics);
+    }
+    else if (strcmp(input_get_backend_name(), "gpio") == 0)
+    {
+        haptics_initialize("gpio"); // Cabinet with the JoyPi
+    }
+    if (!options.mute)
+    {
+        audio_initialize("sound");
+    }
+    if (options.spectate_address)
+    {
+        spectator_start(options.spectate_address);
+    }
+    if (options.telemetry_name)
+    {
+        telemetry_start(options.telemetry_name);
+    }
+    if (options.bot_path)
+    {
+        ensure_condition(bot_start(options.bot_path), "initializeGame(): No bot connected");
+    }
+    if (options.watch_level)
+    {
+        size_t size;
+        if (level_file_find_packed(levelPath, &size))
+        {
+            printf("The level is loaded from the asset pack, leave out --pack to reload it from %s\n", levelPath);
+        }
+        char path[PATH_MAX];
+        asset_resolve(levelPath, path, sizeof(path));
+        level_watch_start(path);
+    }
+    if (options.rewind_seconds > 0)
+    {
+        rewind_start(options.rewind_seconds);
+    }
+
+    game.keystate = SDL_GetKeyboardState(NULL);
+    if (options.profile)
+    {
+        profiler_toggle_overlay();
+    }
+}
+
+void initializeSimulation()
+{
     initializeTypes();
     initializePlayer(&player);
     initializeLevels();
-    gpio_initialize();
-
-    game.keystate = SDL_GetKeyboardState(NULL);
     game.state = STATE_PLAYING;
 }
 
+int isGameRunning()
+{
+    return game.state != STATE_QUIT;
+}
+
+GAME_STATE getGameState()
+{
+    return game.state;
+}
+
 void handleGameLoop()
 {
+    PacingMode pacing = options.pacing;
+    if (pacing == PACING_VSYNC && !isVsyncEnabled())
+    {
+        printf("VSync is not available, falling back to timer pacing\n");
+        pacing = PACING_SLEEP;
+    }
+
     frame_control_start(FRAME_RATE, MAX_DELTA_TIME);
+    frame_control_set_pacing(pacing);
+    if (pacing == PACING_VSYNC)
+    {
+        frame_control_set_refresh_rate(getDisplayRefreshRate());
+    }
+    frame_control_set_stats_interval(options.pacing_stats_interval);
+    if (bot_is_active())
+    {
+        frame_control_set_fixed_frame_time(1000.0 / FRAME_RATE); // The bot's ticks don't depend on the machine
+    }
 
     while (game.state != STATE_QUIT)
     {
-        gpio_poll_and_push_events();
-        processFrame();
-        frame_control_wait_for_next_frame();
-        
+        if (level_watch_changed() && reloadLevels() > 0)
+        {
+            rewind_reset(); // The history has the old rooms
+        }
+        if (bot_is_active())
+        {
+            processFrame(); // As fast as the bot steps, without waiting for the next frame
+        }
+        else if (options.low_latency)
+        {
+            PROFILE(PHASE_WAIT) frame_control_wait_for_next_frame();
+            processFrameLowLatency();
+        }
+        else
+        {
+            processFrame();
+            PROFILE(PHASE_WAIT) frame_control_wait_for_next_frame();
+        }
+        profiler_end_frame();
+        telemetry_publish();
     }
 }
@@ -1,17 +1,51 @@
 #ifndef GAME_H
 #define GAME_H
 
-#define BUTTON_LEFT_PRESSED SDL_USEREVENT + 1
-#define BUTTON_RIGHT_PRESSED SDL_USEREVENT + 2
-
+#include "snapshot.h"
 #include "types.h"
 
+// Buttons held during a frame, as read by the game logic and stored in replays
+typedef enum
+{
+    INPUT_LEFT = 1,
+    INPUT_RIGHT = 2,
+    INPUT_UP = 4,
+    INPUT_DOWN = 8,
+    INPUT_SPACE = 16
+} InputFlags;
+
+typedef enum
+{
+    STATE_QUIT = 0,
+    STATE_PLAYING,
+    STATE_KILLED,
+    STATE_GAMEOVER,
+    STATE_LEVELCOMPLETE
+} GAME_STATE;
+
 extern Level* level;
 extern Player player;
 
 void initializeGame();
 void handleGameLoop();
 
+// Game logic only, without window, fonts and GPIO (used by the tools)
+void initializeSimulation();
+void processTick(Uint8 input);
+int isGameRunning();
+GAME_STATE getGameState();
+
+// The whole simulation state: game, player and world, see snapshot.h.
+// Loading replaces the current state, the snapshot stays valid.
+void saveGame(Snapshot *snapshot);
+void loadGame(const Snapshot *snapshot);
+
+// Rollback versus mode over the connection of net_host() or net_join(),
+// after initializeSimulation(). Both players start at the start position.
+void initializeVersus();
+int processVersusFrame(Uint8 input); // Returns 0 if it waited for the peer instead of simulating a tick
+int getVersusTick();                 // Next tick to simulate
+
 
 void setLevel( int r, int c );
 void completeLevel();
@@ -1,42 +1,35 @@
-
 #include "gpio_control.h"
-#include <sys/time.h>
-#include <unistd.h>
+
+#ifdef HAVE_WIRINGPI
+#include <wiringPi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
 
-// Debounce duration in milliseconds
-#define DEBOUNCE_TIME 20
-// Continuous press event generation interval in milliseconds
-#define PRESS_EVENT_INTERVAL 100
+// Sampling period of the fallback thread when the character device is not available
+static const long long POLL_PERIOD = 1000000LL; // Nanoseconds
+// Longest time the edge thread blocks before it checks for shutdown
+static const int EDGE_WAIT_TIMEOUT = 5; // Milliseconds
+enum { EVENT_BUFFER_SIZE = 64 }; // Edges the kernel buffers for the line request
 
-// Utility function to get current time in milliseconds
-long get_current_time_millis(void) {
-    struct timeval time;
-    gettimeofday(&time, NULL);
-    return (time.tv_sec * 1000) + (time.tv_usec / 1000);
-}
+static const int buttonPins[BUTTON_COUNT] = {BUTTON_PIN_LEFT, BUTTON_PIN_RIGHT, BUTTON_PIN_UP, BUTTON_PIN_DOWN, BUTTON_PIN_SPACE};
 
-
-void gpio_initialize(void) {
-    if (wiringPiSetup() == -1) {
-        fprintf(stderr, "wiringPi setup failed.\n");
-        exit(EXIT_FAILURE); // Exit if wiringPi setup fails
-    }
-
-    // Initialize pins for left, right, up, down, and space buttons
-    pinMode(BUTTON_PIN_LEFT, INPUT);
-    pullUpDnControl(BUTTON_PIN_LEFT, PUD_UP);
-    pinMode(BUTTON_PIN_RIGHT, INPUT);
-    pullUpDnControl(BUTTON_PIN_RIGHT, PUD_UP);
-    pinMode(BUTTON_PIN_UP, INPUT);
-    pullUpDnControl(BUTTON_PIN_UP, PUD_UP);
-    pinMode(BUTTON_PIN_DOWN, INPUT);
-    pullUpDnControl(BUTTON_PIN_DOWN, PUD_UP);
-    pinMode(BUTTON_PIN_SPACE, INPUT);
-    pullUpDnControl(BUTTON_PIN_SPACE, PUD_UP);
-    printf("GPIO setup success.\n");
-}
+static struct {
+    pthread_t thread;
+    atomic_int running;
+    int line_fd; // Line request of the character device, -1 when sampling with digitalRead
+    unsigned int offsets[BUTTON_COUNT]; // BCM line numbers
+    InputDebouncer debouncer;
+} gpio = {.line_fd = -1};
 
 int gpio_read_left_button(void) {
     return digitalRead(BUTTON_PIN_LEFT) == LOW; // Button is pressed when pin is LOW
@@ -58,69 +51,127 @@ int gpio_read_space_button(void) {
     return digitalRead(BUTTON_PIN_SPACE) == LOW; // Button is pressed when pin is LOW
 }
 
+// Requests all button lines as inputs with pull-ups and events on both edges
+static int open_line_events(void) {
+    const int chip = open(GPIO_CHIP_PATH, O_RDONLY | O_CLOEXEC);
+    if (chip < 0) {
+        return -1;
+    }
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    for (int i = 0; i < BUTTON_COUNT; ++i) {
+        gpio.offsets[i] = wpiPinToGpio(buttonPins[i]);
+        request.offsets[i] = gpio.offsets[i];
+    }
+    request.num_lines = BUTTON_COUNT;
+    request.event_buffer_size = EVENT_BUFFER_SIZE;
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_BIAS_PULL_UP |
+                           GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    strncpy(request.consumer, "sdl_platformer", sizeof(request.consumer) - 1);
+    const int result = ioctl(chip, GPIO_V2_GET_LINE_IOCTL, &request);
+    close(chip);
+    return result < 0 ? -1 : request.fd;
+}
 
+static int read_line_level(int button) {
+    struct gpio_v2_line_values values = {0, 1ULL << button};
+    if (ioctl(gpio.line_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+        return gpio.debouncer.pressed[button];
+    }
+    return !(values.bits & (1ULL << button)); // Button is pressed when the line is low
+}
 
-// Last button states, last time they were updated, and last time event was generated
-static int lastButtonState[5] = {HIGH, HIGH, HIGH, HIGH, HIGH};
-static long lastDebounceTime[5] = {0, 0, 0, 0, 0};
-static long lastEventTime[5] = {0, 0, 0, 0, 0};
+// Blocks on the edge events of the character device, the kernel timestamps them
+static void run_edge_events(void) {
+    struct gpio_v2_line_event edges[16];
+    struct pollfd fd = {gpio.line_fd, POLLIN, 0};
+
+    while (atomic_load_explicit(&gpio.running, memory_order_relaxed)) {
+        if (poll(&fd, 1, EDGE_WAIT_TIMEOUT) > 0) {
+            const ssize_t size = read(gpio.line_fd, edges, sizeof(edges));
+            for (int e = 0; e < size / (ssize_t)sizeof(edges[0]); ++e) {
+                for (int i = 0; i < BUTTON_COUNT; ++i) {
+                    if (edges[e].offset == gpio.offsets[i]) {
+                        input_debounce(&gpio.debouncer, i, edges[e].id == GPIO_V2_LINE_EVENT_FALLING_EDGE, edges[e].timestamp_ns);
+                    }
+                }
+            }
+        }
 
-void gpio_poll_and_push_events(void) {
-    // Current time in milliseconds
-    long currentTime = get_current_time_millis();
+        // A suppressed edge may have been the last one, so read the settled level
+        const long long now = input_get_time_ns();
+        for (int i = 0; i < BUTTON_COUNT; ++i) {
+            if (input_debounce_expired(&gpio.debouncer, i, now)) {
+                input_debounce(&gpio.debouncer, i, read_line_level(i), now);
+            }
+        }
+    }
+}
+
+// Fallback without the character device: samples the pins with digitalRead at 1 kHz
+static void run_sampling(void) {
+    long long next = input_get_time_ns();
+    while (atomic_load_explicit(&gpio.running, memory_order_relaxed)) {
+        next += POLL_PERIOD;
+        const struct timespec t = {next / 1000000000LL, next % 1000000000LL};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+        }
+        const long long now = input_get_time_ns();
+        for (int i = 0; i < BUTTON_COUNT; ++i) {
+            input_debounce(&gpio.debouncer, i, digitalRead(buttonPins[i]) == LOW, now);
+        }
+    }
+}
 
-    // Array of button pins
-    int buttonPins[] = {BUTTON_PIN_LEFT, BUTTON_PIN_RIGHT, BUTTON_PIN_UP, BUTTON_PIN_DOWN, BUTTON_PIN_SPACE};
+static void* input_thread(void* arg) {
+    (void)arg;
+    if (gpio.line_fd >= 0) {
+        run_edge_events();
+    } else {
+        run_sampling();
+    }
+    return NULL;
+}
 
-    // Array of corresponding SDL custom event types for presses
-    Uint32 eventsPress[] = {BUTTON_LEFT_PRESSED, BUTTON_RIGHT_PRESSED, BUTTON_UP_PRESSED, BUTTON_DOWN_PRESSED, BUTTON_SPACE_PRESSED};
+int gpio_initialize(void) {
+    if (wiringPiSetup() == -1) {
+        fprintf(stderr, "wiringPi setup failed.\n");
+        return 0;
+    }
 
-    // Array of corresponding SDL custom event types for releases
-    Uint32 eventsRelease[] = {BUTTON_LEFT_RELEASED, BUTTON_RIGHT_RELEASED, BUTTON_UP_RELEASED, BUTTON_DOWN_RELEASED, BUTTON_SPACE_RELEASED};
+    // Initialize pins for left, right, up, down, and space buttons
+    for (int i = 0; i < BUTTON_COUNT; ++i) {
+        pinMode(buttonPins[i], INPUT);
+        pullUpDnControl(buttonPins[i], PUD_UP);
+    }
 
-    for (int i = 0; i < sizeof(buttonPins) / sizeof(buttonPins[0]); ++i) {
-        int currentButtonState = digitalRead(buttonPins[i]);
+    gpio.line_fd = open_line_events();
+    atomic_store(&gpio.running, 1);
+    if (pthread_create(&gpio.thread, NULL, input_thread, NULL) != 0) {
+        fprintf(stderr, "GPIO input thread creation failed.\n");
+        atomic_store(&gpio.running, 0);
+        return 0;
+    }
+    printf("GPIO setup success (%s).\n", gpio.line_fd >= 0 ? "edge events from " GPIO_CHIP_PATH : "sampling at 1 kHz");
+    return 1;
+}
 
-        // Generate press or release event based on state change
-        if (currentButtonState != lastButtonState[i] && (currentTime - lastDebounceTime[i] > DEBOUNCE_TIME)) {
-            SDL_Event event;
-            SDL_zero(event);
-            if (currentButtonState == LOW) {
-                // Button pressed
-                event.type = eventsPress[i];
-            } else {
-                // Button released
-                event.type = eventsRelease[i];
-            }
-            SDL_PushEvent(&event);
-            lastDebounceTime[i] = currentTime;
-            lastButtonState[i] = currentButtonState;
-        }
+void gpio_shutdown(void) {
+    if (!atomic_exchange(&gpio.running, 0)) {
+        return;
+    }
+    pthread_join(gpio.thread, NULL);
+    if (gpio.line_fd >= 0) {
+        close(gpio.line_fd);
+        gpio.line_fd = -1;
     }
 }
 
+static int initialize_backend(const char* argument) {
+    (void)argument;
+    return gpio_initialize();
+}
 
+const InputBackend gpioInputBackend = {"gpio", initialize_backend, NULL, gpio_shutdown};
 
-    // static int lastLeftState = 0, lastRightState = 0, lastUpState = 0, lastDownState = 0, lastSpaceState = 0;
-    // static long lastDebounceTime[5] = {0}; // Array to track the last debounce time for each button
-
-    // // Poll each button and push events for state changes
-    // int currentStates[] = {readLeftButton(), readRightButton(), readUpButton(), readDownButton(), readSpaceButton()};
-    // int *lastStates[] = {&lastLeftState, &lastRightState, &lastUpState, &lastDownState, &lastSpaceState};
-    // Uint32 events[] = {BUTTON_LEFT_PRESSED, BUTTON_RIGHT_PRESSED, BUTTON_UP_PRESSED, BUTTON_DOWN_PRESSED, BUTTON_SPACE_PRESSED};
-    
-    // long currentTime = getCurrentTimeMillis();
-
-    // for (int i = 0; i < sizeof(currentStates) / sizeof(currentStates[0]); ++i) {
-    //     if (currentStates[i] != *lastStates[i] && (currentTime - lastDebounceTime[i]) > DEBOUNCE_TIME) {
-    //         if (currentStates[i] == 1) { // Button press detected
-    //             SDL_Event event;
-    //             SDL_zero(event);
-    //             event.type = events[i];
-    //             printf("Button %d pressed, pushing event\n", i);
-    //             SDL_PushEvent(&event);
-    //         }
-    //         *lastStates[i] = currentStates[i]; // Update last state
-    //         lastDebounceTime[i] = currentTime; // Update last debounce time
-    //     }
-    // }
+#endif // HAVE_WIRINGPI
@@ -1,8 +1,7 @@
 #ifndef GPIO_CONTROL_H
 #define GPIO_CONTROL_H
 
-#include <wiringPi.h>
-#include <SDL2/SDL.h>
+#include "input.h"
 
 // Define your GPIO pin numbers here
 #define BUTTON_PIN_LEFT 6  // WiringPi pin number for left button
@@ -11,27 +10,21 @@
 #define BUTTON_PIN_DOWN 23  // WiringPi pin number for down button
 #define BUTTON_PIN_SPACE 21
 
-// SDL Custom Event Definitions
-#define BUTTON_LEFT_PRESSED SDL_USEREVENT + 1
-#define BUTTON_RIGHT_PRESSED SDL_USEREVENT + 2
-#define BUTTON_UP_PRESSED SDL_USEREVENT + 3
-#define BUTTON_DOWN_PRESSED SDL_USEREVENT + 4
-#define BUTTON_SPACE_PRESSED SDL_USEREVENT + 5
-
-#define BUTTON_LEFT_RELEASED SDL_USEREVENT + 6
-#define BUTTON_RIGHT_RELEASED SDL_USEREVENT + 7
-#define BUTTON_UP_RELEASED SDL_USEREVENT + 8
-#define BUTTON_DOWN_RELEASED SDL_USEREVENT + 9
-#define BUTTON_SPACE_RELEASED SDL_USEREVENT + 10
+// GPIO character device with the BCM lines of the buttons
+#define GPIO_CHIP_PATH "/dev/gpiochip0"
 
+// Input backend "gpio" for the buttons of the cabinet, only built with HAVE_WIRINGPI
+#ifdef HAVE_WIRINGPI
+extern const InputBackend gpioInputBackend;
 
 // Function Declarations
-void gpio_initialize(void);
+int gpio_initialize(void); // Starts the input thread, returns 0 if wiringPi isn't usable
+void gpio_shutdown(void);
 int gpio_read_left_button(void);
 int gpio_read_right_button(void);
 int gpio_read_up_button(void);
 int gpio_read_down_button(void);
 int gpio_read_space_button(void);
-void gpio_poll_and_push_events(void);
+#endif
 
 #endif // GPIO_CONTROL_H
@@ -0,0 +1,272 @@
+#include "haptics.h"
+#include "spsc_queue.h"
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_WIRINGPI
+#include <wiringPi.h>
+#endif
+
+enum {
+    TICK_MS = 5,            // Resolution of the timer wheel
+    WHEEL_SLOTS = 64,       // One turn of the wheel is 320 ms, longer delays take rounds
+    TIMER_COUNT = 128,
+    COMMAND_QUEUE_SIZE = 32,
+    IDLE_TIMEOUT_MS = 100,  // Longest wait for a command before checking for shutdown
+    MAX_PULSES = 4
+};
+
+// Pulses of a pattern, the motor is on for on_ms and then off for off_ms
+typedef struct {
+    int on_ms;
+    int off_ms;
+} Pulse;
+static const Pulse PATTERNS[HAPTIC_COUNT][MAX_PULSES] = {
+    [HAPTIC_DAMAGE] = {{80, 0}},
+    [HAPTIC_KILLED] = {{150, 80}, {150, 80}, {300, 0}},
+};
+
+// Changes the number of active pulses when its slot comes round for the last time
+typedef struct Timer {
+    int delta;
+    int rounds;
+    struct Timer* next;
+} Timer;
+
+static struct {
+    pthread_t thread;
+    atomic_int running;
+    sem_t wake;             // Posted by the game thread for every command
+    SpscQueue commands;     // Game thread to haptics thread
+    atomic_ulong dropped;
+    int muted;              // Owned by the game thread
+    // Pin
+    FILE* file;             // Stand-in pin, NULL when driving the GPIO
+    long long start_time;
+    int level;
+    // Timer wheel, owned by the haptics thread
+    Timer pool[TIMER_COUNT];
+    Timer* free_timers;
+    Timer* slots[WHEEL_SLOTS];
+    unsigned long tick;
+    int pending;            // Timers in the wheel
+    int active;             // Pulses currently on, the motor runs while this is positive
+} haptics = {0};
+
+static long long get_time_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void write_pin(int level) {
+    if (level == haptics.level) {
+        return;
+    }
+    haptics.level = level;
+    if (haptics.file) {
+        fprintf(haptics.file, "%.1f %d\n", (get_time_ns() - haptics.start_time) / 1e6, level);
+        fflush(haptics.file);
+    }
+#ifdef HAVE_WIRINGPI
+    else {
+        digitalWrite(VIBRATION_PIN, level ? HIGH : LOW);
+    }
+#endif
+}
+
+static void apply(int delta) {
+    haptics.active += delta;
+    write_pin(haptics.active > 0);
+}
+
+static int schedule(int delay_ms, int delta) {
+    Timer* timer = haptics.free_timers;
+    if (!timer) {
+        return 0;
+    }
+    haptics.free_timers = timer->next;
+    int ticks = (delay_ms + TICK_MS - 1) / TICK_MS;
+    ticks = ticks > 0 ? ticks : 1;
+    const int slot = (haptics.tick + ticks) % WHEEL_SLOTS;
+    timer->delta = delta;
+    timer->rounds = (ticks - 1) / WHEEL_SLOTS;
+    timer->next = haptics.slots[slot];
+    haptics.slots[slot] = timer;
+    haptics.pending++;
+    return 1;
+}
+
+static int free_timer_count(void) {
+    int count = 0;
+    for (Timer* timer = haptics.free_timers; timer; timer = timer->next) {
+        ++count;
+    }
+    return count;
+}
+
+// Switches the first pulse on at once and schedules every other edge
+static void start_pattern(HapticPattern pattern) {
+    int needed = 0;
+    for (int p = 0; p < MAX_PULSES && PATTERNS[pattern][p].on_ms > 0; ++p) {
+        needed += p > 0 ? 2 : 1;
+    }
+    if (free_timer_count() < needed) {
+        atomic_fetch_add_explicit(&haptics.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    int start = 0;
+    for (int p = 0; p < MAX_PULSES && PATTERNS[pattern][p].on_ms > 0; ++p) {
+        if (start == 0) {
+            apply(+1);
+        } else {
+            schedule(start, +1);
+        }
+        schedule(start + PATTERNS[pattern][p].on_ms, -1);
+        start += PATTERNS[pattern][p].on_ms + PATTERNS[pattern][p].off_ms;
+    }
+}
+
+static void advance_wheel(void) {
+    haptics.tick++;
+    Timer** link = &haptics.slots[haptics.tick % WHEEL_SLOTS];
+    while (*link) {
+        Timer* timer = *link;
+        if (timer->rounds > 0) {
+            timer->rounds--;
+            link = &timer->next;
+            continue;
+        }
+        *link = timer->next;
+        apply(timer->delta);
+        timer->next = haptics.free_timers;
+        haptics.free_timers = timer;
+        haptics.pending--;
+    }
+}
+
+static void sleep_until(long long time) {
+    const struct timespec t = {time / 1000000000LL, time % 1000000000LL};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+    }
+}
+
+static void* haptics_thread(void* arg) {
+    (void)arg;
+    long long next_tick = get_time_ns();
+    while (atomic_load_explicit(&haptics.running, memory_order_relaxed)) {
+        if (haptics.pending == 0) {
+            // Nothing scheduled, sleep until the game sends a pattern
+            struct timespec timeout;
+            clock_gettime(CLOCK_REALTIME, &timeout);
+            timeout.tv_nsec += IDLE_TIMEOUT_MS * 1000000L;
+            timeout.tv_sec += timeout.tv_nsec / 1000000000L;
+            timeout.tv_nsec %= 1000000000L;
+            sem_timedwait(&haptics.wake, &timeout);
+            next_tick = get_time_ns();
+        } else {
+            next_tick += TICK_MS * 1000000LL;
+            sleep_until(next_tick);
+            advance_wheel();
+        }
+
+        unsigned char pattern;
+        while (spsc_queue_pop(&haptics.commands, &pattern)) {
+            start_pattern(pattern);
+        }
+    }
+    haptics.active = 0;
+    write_pin(0);
+    return NULL;
+}
+
+void haptics_initialize(const char* pin) {
+    if (pin == NULL || strcmp(pin, "off") == 0) {
+        return;
+    }
+    if (strncmp(pin, "file:", 5) == 0) {
+        haptics.file = fopen(pin + 5, "w");
+        if (!haptics.file) {
+            fprintf(stderr, "Haptics: unable to create %s\n", pin + 5);
+            return;
+        }
+    } else if (strcmp(pin, "gpio") == 0) {
+#ifdef HAVE_WIRINGPI
+        if (wiringPiSetup() == -1) { // Returns at once if the input backend did the setup
+            fprintf(stderr, "Haptics: wiringPi setup failed\n");
+            return;
+        }
+        pinMode(VIBRATION_PIN, OUTPUT);
+        digitalWrite(VIBRATION_PIN, LOW);
+#else
+        fprintf(stderr, "Haptics: built without wiringPi, use file:PATH\n");
+        return;
+#endif
+    } else {
+        fprintf(stderr, "Haptics: unknown pin %s, use gpio, file:PATH or off\n", pin);
+        return;
+    }
+
+    memset(haptics.slots, 0, sizeof(haptics.slots));
+    haptics.free_timers = NULL;
+    for (int t = 0; t < TIMER_COUNT; ++t) {
+        haptics.pool[t].next = haptics.free_timers;
+        haptics.free_timers = &haptics.pool[t];
+    }
+    haptics.tick = 0;
+    haptics.pending = 0;
+    haptics.active = 0;
+    haptics.level = 0;
+    haptics.start_time = get_time_ns();
+
+    if (!spsc_queue_init(&haptics.commands, sizeof(unsigned char), COMMAND_QUEUE_SIZE)) {
+        fprintf(stderr, "Haptics: out of memory\n");
+        return;
+    }
+    sem_init(&haptics.wake, 0, 0);
+    atomic_store(&haptics.running, 1);
+    if (pthread_create(&haptics.thread, NULL, haptics_thread, NULL) != 0) {
+        fprintf(stderr, "Haptics: thread creation failed\n");
+        atomic_store(&haptics.running, 0);
+        sem_destroy(&haptics.wake);
+        spsc_queue_free(&haptics.commands);
+    }
+}
+
+void haptics_shutdown(void) {
+    if (!atomic_exchange(&haptics.running, 0)) {
+        return;
+    }
+    sem_post(&haptics.wake);
+    pthread_join(haptics.thread, NULL);
+    sem_destroy(&haptics.wake);
+    spsc_queue_free(&haptics.commands);
+    if (haptics.file) {
+        fclose(haptics.file);
+        haptics.file = NULL;
+    }
+    const unsigned long dropped = atomic_load(&haptics.dropped);
+    if (dropped > 0) {
+        printf("Haptics: %lu patterns dropped\n", dropped);
+    }
+}
+
+void haptics_play(HapticPattern pattern) {
+    if (!atomic_load_explicit(&haptics.running, memory_order_relaxed) || haptics.muted) {
+        return;
+    }
+    const unsigned char command = pattern;
+    if (!spsc_queue_push(&haptics.commands, &command)) {
+        atomic_fetch_add_explicit(&haptics.dropped, 1, memory_order_relaxed);
+        return;
+    }
+    sem_post(&haptics.wake); // Never blocks
+}
+
+void haptics_set_muted(int muted) {
+    haptics.muted = muted;
+}
@@ -0,0 +1,25 @@
+#ifndef HAPTICS_H
+#define HAPTICS_H
+
+// Vibration motor of the JoyPi, driven by a background thread
+#define VIBRATION_PIN 2 // WiringPi pin number (BCM 27)
+
+typedef enum {
+    HAPTIC_DAMAGE = 0,
+    HAPTIC_KILLED,
+    HAPTIC_COUNT
+} HapticPattern;
+
+// Starts the haptics thread on the given pin: "gpio" drives VIBRATION_PIN (only with
+// HAVE_WIRINGPI), "file:PATH" logs every level change with its time to PATH instead.
+// NULL or "off" disables haptics.
+void haptics_initialize(const char* pin);
+void haptics_shutdown(void);
+
+// Game thread: queues the pattern, never blocks. Overlapping patterns add up.
+void haptics_play(HapticPattern pattern);
+
+// Game thread: haptics_play() ignores patterns while muted
+void haptics_set_muted(int muted);
+
+#endif /* HAPTICS_H */
@@ -42,7 +42,9 @@ int cell_is_solid_ladder(int r, int c) {
     
     int result = isLadder && (solidAbove || solidBelow || ladderAbove);
     
+#ifdef DEBUG_MODE
     printf("Result for cell_is_solid_ladder(%d, %d) = %d\n", r, c, result);
+#endif
     
     return result;
 }
@@ -130,6 +132,14 @@ Object* find_object(Level* level, ObjectTypeId type_id) {
     return NULL;
 }
 
+Uint32 hash_bytes(const void* data, size_t size, Uint32 hash) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
 double limit_absolute(double value, double max) {
     return value > max ? max : value < -max ? -max : value;
 }
@@ -19,6 +19,9 @@ int find_near_door(int* r, int* c);
 Object* find_near_item(int r, int c);
 Object* find_object(Level* level, ObjectTypeId type_id);
 
+enum { HASH_INITIAL = 2166136261u };
+Uint32 hash_bytes(const void* data, size_t size, Uint32 hash); // FNV-1a, chain calls with the previous result
+
 double limit_absolute(double value, double max);
 void ensure_condition(int condition, const char* message);
 
@@ -0,0 +1,155 @@
+#include "input.h"
+#include "gpio_control.h"
+#include "input_keyboard.h"
+#include "input_sim.h"
+#include "spsc_queue.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum { EVENT_QUEUE_SIZE = 256 };
+// Edges following an accepted edge closer than this are contact bounce
+static const long long DEBOUNCE_TIME = 20 * 1000000LL; // Nanoseconds
+
+static const InputBackend* const BACKENDS[] = {
+#ifdef HAVE_WIRINGPI
+    &gpioInputBackend,
+#endif
+    &keyboardInputBackend,
+    &simInputBackend,
+};
+static const int BACKEND_COUNT = sizeof(BACKENDS) / sizeof(BACKENDS[0]);
+
+static struct {
+    const InputBackend* backend;
+    SpscQueue events;
+    atomic_ulong dropped;
+    unsigned long popped;   // Main thread only
+} input = {0};
+
+long long input_get_time_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static const InputBackend* find_backend(const char* name, size_t length) {
+    for (int i = 0; i < BACKEND_COUNT; ++i) {
+        if (strlen(BACKENDS[i]->name) == length && strncmp(BACKENDS[i]->name, name, length) == 0) {
+            return BACKENDS[i];
+        }
+    }
+    return NULL;
+}
+
+static int start_backend(const InputBackend* backend, const char* argument) {
+    input.backend = backend;
+    if (!backend->initialize(argument)) {
+        input.backend = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void input_initialize(const char* backend) {
+    if (!spsc_queue_init(&input.events, sizeof(ButtonEvent), EVENT_QUEUE_SIZE)) {
+        fprintf(stderr, "Input event queue allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (backend == NULL || strcmp(backend, "auto") == 0) {
+#ifdef HAVE_WIRINGPI
+        if (start_backend(&gpioInputBackend, NULL)) {
+            return;
+        }
+#endif
+        if (!start_backend(&keyboardInputBackend, NULL)) {
+            fprintf(stderr, "No input backend available\n");
+            exit(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    const char* separator = strchr(backend, ':');
+    const size_t length = separator ? (size_t)(separator - backend) : strlen(backend);
+    const InputBackend* selected = find_backend(backend, length);
+    if (!selected) {
+        fprintf(stderr, "Unknown input backend %.*s, available:", (int)length, backend);
+        for (int i = 0; i < BACKEND_COUNT; ++i) {
+            fprintf(stderr, " %s", BACKENDS[i]->name);
+        }
+        fprintf(stderr, "\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!start_backend(selected, separator ? separator + 1 : NULL)) {
+        fprintf(stderr, "Input backend %s is not available\n", selected->name);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void input_shutdown(void) {
+    if (!input.backend) {
+        return;
+    }
+    input.backend->shutdown();
+    input.backend = NULL;
+    spsc_queue_free(&input.events);
+    const unsigned long dropped = atomic_load(&input.dropped);
+    if (dropped > 0) {
+        printf("Input: %lu button events dropped, the event queue was full\n", dropped);
+    }
+}
+
+const char* input_get_backend_name(void) {
+    return input.backend ? input.backend->name : "none";
+}
+
+void input_handle_event(const SDL_Event* event) {
+    if (input.backend && input.backend->handle_event) {
+        input.backend->handle_event(event);
+    }
+}
+
+int input_pop_event(ButtonEvent* event) {
+    if (!input.backend || !spsc_queue_pop(&input.events, event)) {
+        return 0;
+    }
+    input.popped += 1;
+    return 1;
+}
+
+unsigned long input_get_event_count(void) {
+    return input.popped;
+}
+
+unsigned long input_get_dropped_count(void) {
+    return atomic_load_explicit(&input.dropped, memory_order_relaxed);
+}
+
+void input_publish(Button button, int pressed, long long time) {
+    const ButtonEvent event = {button, pressed, time};
+    if (!spsc_queue_push(&input.events, &event)) {
+        atomic_fetch_add_explicit(&input.dropped, 1, memory_order_relaxed);
+    }
+}
+
+void input_debounce(InputDebouncer* debouncer, Button button, int pressed, long long time) {
+    if (pressed == debouncer->pressed[button]) {
+        debouncer->unsettled[button] = 0;
+        return;
+    }
+    if (time - debouncer->last_change[button] < DEBOUNCE_TIME) {
+        debouncer->unsettled[button] = 1;
+        return;
+    }
+    debouncer->pressed[button] = pressed;
+    debouncer->last_change[button] = time;
+    debouncer->unsettled[button] = 0;
+    input_publish(button, pressed, time);
+}
+
+int input_debounce_expired(const InputDebouncer* debouncer, Button button, long long time) {
+    return debouncer->unsettled[button] && time - debouncer->last_change[button] >= DEBOUNCE_TIME;
+}
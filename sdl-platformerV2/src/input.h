@@ -0,0 +1,59 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <SDL2/SDL.h>
+
+// Buttons in the order of their INPUT_* flags, so (1 << button) is the flag
+typedef enum {
+    BUTTON_LEFT = 0,
+    BUTTON_RIGHT,
+    BUTTON_UP,
+    BUTTON_DOWN,
+    BUTTON_SPACE,
+    BUTTON_COUNT
+} Button;
+
+// A debounced press or release, published by the active input backend
+typedef struct {
+    Uint8 button;
+    Uint8 pressed;
+    long long time; // CLOCK_MONOTONIC nanoseconds of the edge
+} ButtonEvent;
+
+// Source of button events. Exactly one backend is active, it publishes its events from
+// one thread, either its own or the main thread from handle_event().
+typedef struct {
+    const char* name;
+    int (*initialize)(const char* argument); // Returns 0 if the backend isn't available
+    void (*handle_event)(const SDL_Event* event); // Optional, called on the main thread for every SDL event
+    void (*shutdown)(void);
+} InputBackend;
+
+// Starts the backend given as "name" or "name:argument". "auto" (or NULL) takes the
+// GPIO buttons if they are available and the keyboard otherwise. Exits if the backend fails.
+void input_initialize(const char* backend);
+void input_shutdown(void);
+const char* input_get_backend_name(void);
+
+void input_handle_event(const SDL_Event* event); // Main thread
+int input_pop_event(ButtonEvent* event);         // Main thread, returns 0 if no event is pending
+unsigned long input_get_event_count(void);       // Main thread, events popped since the start
+unsigned long input_get_dropped_count(void);     // Events lost because the queue was full
+
+// Backend side
+void input_publish(Button button, int pressed, long long time);
+long long input_get_time_ns(void);
+
+// Debounce state of raw button edges, owned by the thread of one backend
+typedef struct {
+    int pressed[BUTTON_COUNT];
+    int unsettled[BUTTON_COUNT]; // An edge was suppressed, the level has to be checked again
+    long long last_change[BUTTON_COUNT];
+} InputDebouncer;
+
+// Publishes the first edge of a button at once and ignores the bounce in the 20 ms after it
+void input_debounce(InputDebouncer* debouncer, Button button, int pressed, long long time);
+// Whether a suppressed edge needs the settled level of the button now
+int input_debounce_expired(const InputDebouncer* debouncer, Button button, long long time);
+
+#endif /* INPUT_H */
@@ -0,0 +1,86 @@
+#include "input_keyboard.h"
+#include <string.h>
+
+enum {
+    SOURCE_KEY = 1,
+    SOURCE_PAD_BUTTON = 2,
+    SOURCE_STICK = 4,
+    STICK_THRESHOLD = 16000 // Of the axis range -32768..32767
+};
+
+static const SDL_Scancode KEYS[BUTTON_COUNT] = {
+    SDL_SCANCODE_LEFT, SDL_SCANCODE_RIGHT, SDL_SCANCODE_UP, SDL_SCANCODE_DOWN, SDL_SCANCODE_SPACE
+};
+static const SDL_GameControllerButton PAD_BUTTONS[BUTTON_COUNT] = {
+    SDL_CONTROLLER_BUTTON_DPAD_LEFT, SDL_CONTROLLER_BUTTON_DPAD_RIGHT, SDL_CONTROLLER_BUTTON_DPAD_UP,
+    SDL_CONTROLLER_BUTTON_DPAD_DOWN, SDL_CONTROLLER_BUTTON_A
+};
+
+// Sources holding each button, a button is pressed while any of them holds it
+static Uint8 sources[BUTTON_COUNT];
+
+static void set_source(Button button, Uint8 source, int held) {
+    const int was_pressed = sources[button] != 0;
+    if (held) {
+        sources[button] |= source;
+    } else {
+        sources[button] &= ~source;
+    }
+    const int pressed = sources[button] != 0;
+    if (pressed != was_pressed) {
+        input_publish(button, pressed, input_get_time_ns());
+    }
+}
+
+static int initialize_backend(const char* argument) {
+    (void)argument;
+    memset(sources, 0, sizeof(sources));
+    // Without the controller subsystem the keyboard still works, connected controllers
+    // arrive as SDL_CONTROLLERDEVICEADDED events
+    SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER);
+    return 1;
+}
+
+static void handle_event(const SDL_Event* event) {
+    switch (event->type) {
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            if (!event->key.repeat) {
+                for (int b = 0; b < BUTTON_COUNT; ++b) {
+                    if (event->key.keysym.scancode == KEYS[b]) {
+                        set_source(b, SOURCE_KEY, event->type == SDL_KEYDOWN);
+                    }
+                }
+            }
+            break;
+
+        case SDL_CONTROLLERDEVICEADDED:
+            SDL_GameControllerOpen(event->cdevice.which);
+            break;
+
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            for (int b = 0; b < BUTTON_COUNT; ++b) {
+                if (event->cbutton.button == PAD_BUTTONS[b]) {
+                    set_source(b, SOURCE_PAD_BUTTON, event->type == SDL_CONTROLLERBUTTONDOWN);
+                }
+            }
+            break;
+
+        case SDL_CONTROLLERAXISMOTION:
+            if (event->caxis.axis == SDL_CONTROLLER_AXIS_LEFTX) {
+                set_source(BUTTON_LEFT, SOURCE_STICK, event->caxis.value < -STICK_THRESHOLD);
+                set_source(BUTTON_RIGHT, SOURCE_STICK, event->caxis.value > STICK_THRESHOLD);
+            } else if (event->caxis.axis == SDL_CONTROLLER_AXIS_LEFTY) {
+                set_source(BUTTON_UP, SOURCE_STICK, event->caxis.value < -STICK_THRESHOLD);
+                set_source(BUTTON_DOWN, SOURCE_STICK, event->caxis.value > STICK_THRESHOLD);
+            }
+            break;
+    }
+}
+
+static void shutdown_backend(void) {
+    SDL_QuitSubSystem(SDL_INIT_GAMECONTROLLER);
+}
+
+const InputBackend keyboardInputBackend = {"keyboard", initialize_backend, handle_event, shutdown_backend};
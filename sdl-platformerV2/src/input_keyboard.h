@@ -0,0 +1,10 @@
+#ifndef INPUT_KEYBOARD_H
+#define INPUT_KEYBOARD_H
+
+#include "input.h"
+
+// Input backend "keyboard": arrow keys and space, game controllers with the d-pad,
+// the left stick and the A button
+extern const InputBackend keyboardInputBackend;
+
+#endif /* INPUT_KEYBOARD_H */
@@ -0,0 +1,163 @@
+#include "input_sim.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Longest time the thread blocks before it checks for shutdown and bounced edges
+static const long long WAIT_SLICE = 5 * 1000000LL; // Nanoseconds
+enum { LINE_SIZE = 128 };
+
+static const char* const BUTTON_NAMES[BUTTON_COUNT] = {"left", "right", "up", "down", "space"};
+
+static struct {
+    pthread_t thread;
+    atomic_int running;
+    int fd;
+    char buffer[LINE_SIZE];
+    int length;
+    int level[BUTTON_COUNT]; // Raw simulated levels, 1 while pressed
+    long long next_edge;     // Schedule of the next edge, nanoseconds
+    InputDebouncer debouncer;
+} sim = {.fd = -1};
+
+static void sleep_until(long long time) {
+    const struct timespec t = {time / 1000000000LL, time % 1000000000LL};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR) {
+    }
+}
+
+static void settle_bounces(long long now) {
+    for (int b = 0; b < BUTTON_COUNT; ++b) {
+        if (input_debounce_expired(&sim.debouncer, b, now)) {
+            input_debounce(&sim.debouncer, b, sim.level[b], now);
+        }
+    }
+}
+
+// Waits in slices until the given time, so shutdown and bounce handling stay responsive
+static int wait_until(long long time) {
+    long long now = input_get_time_ns();
+    while (now < time && atomic_load_explicit(&sim.running, memory_order_relaxed)) {
+        sleep_until(time - now > WAIT_SLICE ? now + WAIT_SLICE : time);
+        now = input_get_time_ns();
+        settle_bounces(now);
+    }
+    return atomic_load_explicit(&sim.running, memory_order_relaxed);
+}
+
+static void run_line(const char* line, int number) {
+    double delay;
+    char name[16], action[16];
+    while (*line == ' ' || *line == '\t') {
+        ++line;
+    }
+    if (*line == '#' || *line == '\0') {
+        return;
+    }
+    if (sscanf(line, "%lf %15s %15s", &delay, name, action) != 3) {
+        fprintf(stderr, "Input script line %d: expected <delay ms> <button> <press|release>\n", number);
+        return;
+    }
+    int button = -1;
+    for (int b = 0; b < BUTTON_COUNT; ++b) {
+        if (strcmp(name, BUTTON_NAMES[b]) == 0) {
+            button = b;
+        }
+    }
+    const int pressed = strcmp(action, "press") == 0;
+    if (button < 0 || (!pressed && strcmp(action, "release") != 0)) {
+        fprintf(stderr, "Input script line %d: unknown button or action\n", number);
+        return;
+    }
+
+    // Delays count from the scheduled previous edge, so lateness doesn't accumulate.
+    // After a stall on an empty pipe the schedule restarts at the current time.
+    const long long now = input_get_time_ns();
+    sim.next_edge = (sim.next_edge > now - WAIT_SLICE ? sim.next_edge : now) + (long long)(delay * 1e6);
+    if (!wait_until(sim.next_edge)) {
+        return;
+    }
+    sim.level[button] = pressed;
+    input_debounce(&sim.debouncer, button, pressed, input_get_time_ns());
+}
+
+static void* sim_thread(void* arg) {
+    (void)arg;
+    struct pollfd fd = {sim.fd, POLLIN, 0};
+    int number = 0;
+    int ended = 0;
+    while (atomic_load_explicit(&sim.running, memory_order_relaxed)) {
+        if (ended) {
+            wait_until(input_get_time_ns() + WAIT_SLICE); // The buttons keep their last state
+            continue;
+        }
+        char* end = memchr(sim.buffer, '\n', sim.length);
+        if (end) {
+            *end = '\0';
+            run_line(sim.buffer, ++number);
+            sim.length -= end + 1 - sim.buffer;
+            memmove(sim.buffer, end + 1, sim.length);
+            continue;
+        }
+        if (sim.length == LINE_SIZE - 1) {
+            fprintf(stderr, "Input script line %d is too long\n", ++number);
+            sim.length = 0;
+        }
+
+        if (poll(&fd, 1, WAIT_SLICE / 1000000) > 0) {
+            const ssize_t size = read(sim.fd, sim.buffer + sim.length, LINE_SIZE - 1 - sim.length);
+            if (size <= 0) {
+                if (sim.length > 0) {
+                    sim.buffer[sim.length] = '\0'; // Last line without newline
+                    run_line(sim.buffer, ++number);
+                    sim.length = 0;
+                }
+                ended = 1;
+                continue;
+            }
+            sim.length += size;
+        }
+        settle_bounces(input_get_time_ns());
+    }
+    return NULL;
+}
+
+static int initialize_backend(const char* path) {
+    if (path == NULL) {
+        fprintf(stderr, "Input backend sim needs a script, use sim:FILE\n");
+        return 0;
+    }
+    sim.fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (sim.fd < 0) {
+        fprintf(stderr, "Unable to open input script %s\n", path);
+        return 0;
+    }
+    sim.length = 0;
+    sim.next_edge = 0;
+    memset(sim.level, 0, sizeof(sim.level));
+    memset(&sim.debouncer, 0, sizeof(sim.debouncer));
+    atomic_store(&sim.running, 1);
+    if (pthread_create(&sim.thread, NULL, sim_thread, NULL) != 0) {
+        close(sim.fd);
+        sim.fd = -1;
+        return 0;
+    }
+    printf("Simulated GPIO input from %s\n", path);
+    return 1;
+}
+
+static void shutdown_backend(void) {
+    atomic_store(&sim.running, 0);
+    pthread_join(sim.thread, NULL);
+    close(sim.fd);
+    sim.fd = -1;
+}
+
+const InputBackend simInputBackend = {"sim", initialize_backend, NULL, shutdown_backend};
@@ -0,0 +1,13 @@
+#ifndef INPUT_SIM_H
+#define INPUT_SIM_H
+
+#include "input.h"
+
+// Input backend "sim:FILE", a simulated GPIO device. A thread reads raw edges from FILE,
+// which may be a pipe, and debounces them like the real buttons. One edge per line:
+//     <delay ms> <left|right|up|down|space> <press|release>
+// The delay counts from the previous edge, lines starting with # are comments. The
+// edge is timestamped when it is emitted.
+extern const InputBackend simInputBackend;
+
+#endif /* INPUT_SIM_H */
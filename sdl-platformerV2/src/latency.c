@@ -0,0 +1,117 @@
+#include "latency.h"
+#include <stdio.h>
+#include <time.h>
+
+enum {
+    HISTOGRAM_BINS = 400,   // 0.25 ms bins up to 100 ms, the last one collects the rest
+};
+static const double HISTOGRAM_BIN_MS = 0.25;
+static const long long NO_INPUT = -1;
+
+const char* const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = {"simulated", "presented"};
+
+typedef struct {
+    unsigned int histogram[HISTOGRAM_BINS];
+    unsigned long count;
+    double total;           // Milliseconds
+    double max;             // Milliseconds
+} LatencyStats;
+
+static struct {
+    long long observed;     // Time of the oldest input the simulation hasn't read, nanoseconds
+    long long consumed;     // Time of the oldest input read but not presented, nanoseconds
+    int simulated;          // The consumed input has been simulated
+    LatencyStats stages[LATENCY_STAGE_COUNT];
+} latency = {NO_INPUT, NO_INPUT};
+
+static inline long long get_time_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void add_sample(LatencyStage stage, long long since) {
+    LatencyStats* stats = &latency.stages[stage];
+    const double ms = (get_time_ns() - since) / 1e6;
+    int bin = ms / HISTOGRAM_BIN_MS;
+    if (bin >= HISTOGRAM_BINS) {
+        bin = HISTOGRAM_BINS - 1;
+    }
+    stats->histogram[bin]++;
+    stats->count++;
+    stats->total += ms;
+    if (ms > stats->max) {
+        stats->max = ms;
+    }
+}
+
+void latency_mark_input(void) {
+    latency_mark_input_at(get_time_ns());
+}
+
+void latency_mark_input_at(long long time) {
+    if (latency.observed == NO_INPUT || time < latency.observed) {
+        latency.observed = time;
+    }
+}
+
+void latency_input_consumed(void) {
+    if (latency.observed != NO_INPUT && latency.consumed == NO_INPUT) {
+        latency.consumed = latency.observed;
+        latency.simulated = 0;
+    }
+    latency.observed = NO_INPUT;
+}
+
+void latency_simulated(void) {
+    if (latency.consumed != NO_INPUT && !latency.simulated) {
+        add_sample(LATENCY_SIMULATED, latency.consumed);
+        latency.simulated = 1;
+    }
+}
+
+void latency_presented(void) {
+    if (latency.consumed == NO_INPUT || !latency.simulated) {
+        return;
+    }
+    add_sample(LATENCY_PRESENTED, latency.consumed);
+    latency.consumed = NO_INPUT;
+}
+
+unsigned long latency_get_count(LatencyStage stage) {
+    return latency.stages[stage].count;
+}
+
+double latency_get_mean(LatencyStage stage) {
+    const LatencyStats* stats = &latency.stages[stage];
+    return stats->count ? stats->total / stats->count : 0;
+}
+
+double latency_get_percentile(LatencyStage stage, double share) {
+    const LatencyStats* stats = &latency.stages[stage];
+    const unsigned long target = stats->count * share;
+    unsigned long count = 0;
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        count += stats->histogram[bin];
+        if (count > target) {
+            return (bin + 1) * HISTOGRAM_BIN_MS;
+        }
+    }
+    return HISTOGRAM_BINS * HISTOGRAM_BIN_MS;
+}
+
+double latency_get_max(LatencyStage stage) {
+    return latency.stages[stage].max;
+}
+
+void latency_print_stats(void) {
+    if (latency.stages[LATENCY_SIMULATED].count == 0) {
+        printf("Input latency: no input measured\n");
+        return;
+    }
+    for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        printf("Input latency to %-9s %lu inputs, mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+               LATENCY_STAGE_NAMES[s], latency.stages[s].count, latency_get_mean(s),
+               latency_get_percentile(s, 0.5), latency_get_percentile(s, 0.99), latency.stages[s].max);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+// Measures the time from an input edge to the tick which simulates it and to the end of
+// the present which first shows its effect
+
+typedef enum {
+    LATENCY_SIMULATED = 0,  // Edge to the end of the tick which read it
+    LATENCY_PRESENTED,      // Edge to the return of the following SDL_RenderPresent()
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+extern const char* const LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT]; // As printed in the statistics
+
+void latency_mark_input(void);      // An input edge was observed now, the oldest unconsumed one is kept
+void latency_mark_input_at(long long time); // Same for an edge at the given CLOCK_MONOTONIC nanoseconds
+void latency_input_consumed(void);  // The simulation has read the marked input
+void latency_simulated(void);       // The tick which read the input is done
+void latency_presented(void);       // SDL_RenderPresent() returned
+
+unsigned long latency_get_count(LatencyStage stage);
+double latency_get_mean(LatencyStage stage);      // Milliseconds
+double latency_get_percentile(LatencyStage stage, double share); // Milliseconds
+double latency_get_max(LatencyStage stage);       // Milliseconds
+void latency_print_stats(void);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,607 @@
+#include "level_format.h"
+#include "asset_pack.h"
+#include "helpers.h"
+#include "levels.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Compiler output, grown as the rooms are added
+typedef struct
+{
+    Uint8 *data;
+    size_t size;
+    size_t reserved;
+} Output;
+
+static void append(Output *output, const void *data, size_t size)
+{
+    if (output->size + size > output->reserved)
+    {
+        while (output->size + size > output->reserved)
+        {
+            output->reserved = output->reserved ? output->reserved * 2 : 4096;
+        }
+        output->data = realloc(output->data, output->reserved);
+        ensure_condition(output->data != NULL, "level_compile(): Out of memory");
+    }
+    memcpy(output->data + output->size, data, size);
+    output->size += size;
+}
+
+// Text of the rooms without newlines, room rows follow each other across the world
+typedef struct
+{
+    const char *chars;
+    int roomsX;
+} Text;
+
+static inline char getLevelChar(const Text *text, int lr, int lc, int r, int c)
+{
+    return text->chars[((lr * ROW_COUNT + r) * text->roomsX + lc) * COLUMN_COUNT + c];
+}
+
+// Tile legend: what a character of the text format becomes. The file can add
+// or replace entries with header lines
+//     #legend C [TYPE] [above=TYPE] [below=TYPE] [cover=CHARS] [columns=TYPE,TYPE,...] [data]
+// The TYPE is the type name (see TYPE_NAMES), a '+' in front spawns a dynamic
+// object instead of setting a static cell. "above" is used if the cell above
+// is one of the cover characters, "below" if the cell below is, and the cells
+// outside of the room always count as cover. "columns" cycles the types by the
+// column, "data" gives spawned objects the character as their data.
+static const char DEFAULT_LEGEND[] =
+    "#legend * wall_top above=wall cover=*x\n"
+    "#legend x ground_top above=ground cover=*x\n"
+    "#legend ~ +water_top above=water cover=*x~\n"
+    "#legend | pillar above=pillar_top below=pillar_bottom cover=*x\n"
+    "#legend ^ spike_bottom above=spike_top cover=*x\n"
+    "#legend - wall_stair\n"
+    "#legend , columns=grass,grass,grass_big\n"
+    "#legend . columns=mushroom1,mushroom2,mushroom3\n"
+    "#legend ; columns=tree2,tree1\n"
+    "#legend @ rock\n"
+    "#legend = ladder\n"
+    "#legend d door\n"
+    "#legend < arrow_left\n"
+    "#legend > arrow_right\n"
+    "#legend o +coin\n"
+    "#legend O +gem\n"
+    "#legend k +key\n"
+    "#legend h +heart\n"
+    "#legend a +apple\n"
+    "#legend i +pear\n"
+    "#legend S +statuary\n"
+    "#legend g +ghost\n"
+    "#legend s +scorpion\n"
+    "#legend p +spider\n"
+    "#legend r +rat\n"
+    "#legend b +bat\n"
+    "#legend q +blob\n"
+    "#legend f +fireball\n"
+    "#legend e +skeleton\n"
+    "#legend ` +drop\n"
+    "#legend _ +platform\n"
+    "#legend / +spring\n"
+    "#legend & +cloud1\n"
+    "#legend ! +torch\n"
+    "#legend 1 +action data\n"
+    "#legend 2 +action data\n"
+    "#legend 3 +action data\n"
+    "#legend 4 +action data\n"
+    "#legend 5 +action data\n"
+    "#legend 6 +action data\n"
+    "#legend 7 +action data\n"
+    "#legend 8 +action data\n"
+    "#legend 9 +action data\n";
+
+// In the order of ObjectTypeId
+static const char *const TYPE_NAMES[] = {
+    "none",
+    "ghost", "scorpion", "spider", "rat", "bat", "blob", "fireball", "skeleton", "iceshot", "fireshot",
+    "drop", "platform", "cloud1", "cloud2", "wall_fake", "ground_fake", "player",
+    "heart", "wall_top", "wall", "wall_stair", "ground_top", "ground", "ground_stair", "water", "water_top",
+    "grass", "grass_big", "rock", "spike_top", "spike_bottom", "tree1", "tree2",
+    "mushroom1", "mushroom2", "mushroom3", "pillar", "pillar_top", "pillar_bottom", "torch", "door", "ladder",
+    "spring", "arrow_left", "arrow_right", "arrow_up", "arrow_down",
+    "key", "apple", "pear", "coin", "gem", "statuary", "ladder_part", "pick", "action",
+};
+_Static_assert(sizeof(TYPE_NAMES) / sizeof(TYPE_NAMES[0]) == TYPE_COUNT, "TYPE_NAMES doesn't match ObjectTypeId");
+
+enum { MAX_COLUMN_VARIANTS = 8 };
+
+typedef struct
+{
+    Uint8 type;     // TYPE_NONE for none
+    Uint8 spawn;    // Dynamic object instead of a static cell
+} Tile;
+
+typedef struct
+{
+    Tile columns[MAX_COLUMN_VARIANTS]; // Cycled by column, no entry if columnCount is 0
+    int columnCount;
+    Tile above;
+    Tile below;
+    Uint8 cover[256 / 8];   // Characters which count as cover, one bit each
+    int data;
+} LegendEntry;
+
+// Indexed by the character, so every cell takes one lookup
+static LegendEntry legend[256];
+
+static inline int isCover(const LegendEntry *entry, char s)
+{
+    return entry->cover[(Uint8)s / 8] & (1 << (Uint8)s % 8);
+}
+
+// Parses TYPE or +TYPE, returns 0 for an unknown name
+static int parseTile(const char *name, size_t length, Tile *tile)
+{
+    tile->spawn = length > 0 && name[0] == '+';
+    name += tile->spawn;
+    length -= tile->spawn;
+    for (int i = 1; i < TYPE_COUNT; ++i)
+    {
+        if (strlen(TYPE_NAMES[i]) == length && strncmp(TYPE_NAMES[i], name, length) == 0)
+        {
+            tile->type = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parses the part of a "#legend" line after the keyword
+static int parseLegendLine(const char *line, const char *end)
+{
+    while (line < end && *line == ' ')
+    {
+        ++line;
+    }
+    if (line >= end || (line + 1 < end && line[1] != ' '))
+    {
+        return 0;
+    }
+    LegendEntry entry = {0};
+    const Uint8 character = *line++;
+
+    while (line < end)
+    {
+        while (line < end && *line == ' ')
+        {
+            ++line;
+        }
+        const char *word = line;
+        while (line < end && *line != ' ')
+        {
+            ++line;
+        }
+        const size_t length = line - word;
+        if (length == 0)
+        {
+            break;
+        }
+        const char *value = memchr(word, '=', length);
+        const size_t valueLength = value ? length - (value - word) - 1 : 0;
+        value = value ? value + 1 : NULL;
+
+        if (length == 4 && strncmp(word, "data", 4) == 0)
+        {
+            entry.data = 1;
+        }
+        else if (value && strncmp(word, "above=", 6) == 0)
+        {
+            if (!parseTile(value, valueLength, &entry.above))
+            {
+                return 0;
+            }
+        }
+        else if (value && strncmp(word, "below=", 6) == 0)
+        {
+            if (!parseTile(value, valueLength, &entry.below))
+            {
+                return 0;
+            }
+        }
+        else if (value && strncmp(word, "cover=", 6) == 0)
+        {
+            for (size_t i = 0; i < valueLength; ++i)
+            {
+                entry.cover[(Uint8)value[i] / 8] |= 1 << (Uint8)value[i] % 8;
+            }
+        }
+        else if (value && strncmp(word, "columns=", 8) == 0)
+        {
+            const char *name = value;
+            const char *valueEnd = value + valueLength;
+            while (name < valueEnd)
+            {
+                const char *comma = memchr(name, ',', valueEnd - name);
+                const char *nameEnd = comma ? comma : valueEnd;
+                if (entry.columnCount == MAX_COLUMN_VARIANTS ||
+                    !parseTile(name, nameEnd - name, &entry.columns[entry.columnCount++]))
+                {
+                    return 0;
+                }
+                name = nameEnd + 1;
+            }
+        }
+        else if (entry.columnCount == 0 && !value)
+        {
+            if (!parseTile(word, length, &entry.columns[0]))
+            {
+                return 0;
+            }
+            entry.columnCount = 1;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    legend[character] = entry;
+    return 1;
+}
+
+// Reads the header lines starting with '#' and returns the start of the level data, NULL if a line is invalid.
+// "#world X Y" sets the number of rooms per row and column, without it the world is
+// LEVEL_COUNTX x LEVEL_COUNTY rooms. "#legend" lines change the legend.
+static const char *parseLevelHeader(const char *source, const char *end, LevelFileHeader *header)
+{
+    while (source < end && *source == '#')
+    {
+        const char *next = memchr(source, '\n', end - source);
+        const char *lineEnd = next ? next : end;
+        if (lineEnd > source && lineEnd[-1] == '\r')
+        {
+            --lineEnd;
+        }
+        // The text has no terminating zero, a packed one can't have it, so sscanf() gets a copy of the line
+        char line[64];
+        snprintf(line, sizeof(line), "%.*s", (int)(lineEnd - source), source);
+        int x, y;
+        if (sscanf(line, "#world %d %d", &x, &y) == 2)
+        {
+            header->roomsX = x;
+            header->roomsY = y;
+        }
+        else if (lineEnd - source >= 8 && memcmp(source, "#legend ", 8) == 0 && !parseLegendLine(source + 8, lineEnd))
+        {
+            fprintf(stderr, "Level: invalid legend line: %.*s\n", (int)(lineEnd - source), source);
+            return NULL;
+        }
+        source = next ? next + 1 : end;
+    }
+    return source;
+}
+
+// Returns the first column from c on which isn't empty. Eight cells are
+// compared at once, most rows are mostly empty.
+static inline int skipEmptyCells(const char *row, int c)
+{
+    static const Uint64 EMPTY = 0x2020202020202020ULL; // Eight spaces
+    Uint64 cells;
+    for (; c + 8 <= COLUMN_COUNT; c += 8)
+    {
+        memcpy(&cells, row + c, sizeof(cells));
+        if (cells != EMPTY)
+        {
+            break;
+        }
+    }
+    while (c < COLUMN_COUNT && row[c] == ' ')
+    {
+        ++c;
+    }
+    return c;
+}
+
+// Resolves the tile variants of one room and collects its spawns in row major order
+static void compileRoom(Output *output, const Text *text, int lr, int lc)
+{
+    LevelFileRoom record;
+    LevelFileRoom *room = &record;
+    LevelSpawn spawns[CELL_COUNT];
+    int spawnCount = 0;
+    memset(room->cells, TYPE_NONE, sizeof(room->cells));
+
+    for (int r = 0; r < ROW_COUNT; ++r)
+    {
+        const char *row = &text->chars[((lr * ROW_COUNT + r) * text->roomsX + lc) * COLUMN_COUNT];
+        for (int c = skipEmptyCells(row, 0); c < COLUMN_COUNT; c = skipEmptyCells(row, c + 1))
+        {
+            const char s = row[c];
+            const LegendEntry *entry = &legend[(Uint8)s];
+            if (entry->columnCount == 0)
+            {
+                continue;
+            }
+
+            const Tile *tile = &entry->columns[c % entry->columnCount];
+            if (entry->above.type && (r == 0 || isCover(entry, getLevelChar(text, lr, lc, r - 1, c))))
+            {
+                tile = &entry->above;
+            }
+            else if (entry->below.type && (r == ROW_COUNT - 1 || isCover(entry, getLevelChar(text, lr, lc, r + 1, c))))
+            {
+                tile = &entry->below;
+            }
+
+            const int index = r * COLUMN_COUNT + c;
+            if (tile->spawn)
+            {
+                spawns[spawnCount++] = (LevelSpawn){tile->type, entry->data ? (Uint8)s : 0, index};
+            }
+            else
+            {
+                room->cells[index] = tile->type;
+            }
+        }
+    }
+
+    room->spawnCount = spawnCount;
+    append(output, room, sizeof(*room));
+    append(output, spawns, sizeof(LevelSpawn) * spawnCount);
+}
+
+Uint8 *level_compile(const char *text, size_t length, size_t *size)
+{
+    const char *end = text + length;
+    LevelFileHeader header = {{'P', 'L', 'V', 'L'}, LEVEL_FILE_VERSION, LEVEL_COUNTX, LEVEL_COUNTY, 0, 0};
+    memset(legend, 0, sizeof(legend));
+    parseLevelHeader(DEFAULT_LEGEND, DEFAULT_LEGEND + sizeof(DEFAULT_LEGEND) - 1, &header);
+    const char *source = parseLevelHeader(text, end, &header);
+    if (!source)
+    {
+        return NULL;
+    }
+    if ((int)header.roomsX <= 0 || (int)header.roomsY <= 0)
+    {
+        fprintf(stderr, "Level: invalid world size %d x %d\n", (int)header.roomsX, (int)header.roomsY);
+        return NULL;
+    }
+
+    const size_t roomCount = (size_t)header.roomsX * header.roomsY;
+    char *chars = malloc(end - source + 1);
+    ensure_condition(chars != NULL, "level_compile(): Out of memory");
+    size_t count = 0;
+    for (const char *p = source; p < end; ++p)
+    {
+        if (*p != '\n' && *p != '\r')
+        {
+            chars[count++] = *p;
+        }
+    }
+    if (count != roomCount * CELL_COUNT)
+    {
+        fprintf(stderr, "Level: %zu cells, but %u x %u rooms need %zu\n", count, header.roomsX, header.roomsY,
+                roomCount * CELL_COUNT);
+        free(chars);
+        return NULL;
+    }
+    const char *start = memchr(chars, 'P', count);
+    if (!start)
+    {
+        fprintf(stderr, "Level: the levels have no start position\n");
+        free(chars);
+        return NULL;
+    }
+    const size_t row = (start - chars) / (COLUMN_COUNT * header.roomsX); // Row of cells across the whole world
+    const size_t column = (start - chars) % (COLUMN_COUNT * header.roomsX);
+    header.startRoom = row / ROW_COUNT * header.roomsX + column / COLUMN_COUNT;
+    header.startCell = row % ROW_COUNT * COLUMN_COUNT + column % COLUMN_COUNT;
+
+    // The offsets are filled in as the rooms are appended
+    Output output = {0};
+    append(&output, &header, sizeof(header));
+    const size_t offsetsStart = output.size;
+    Uint32 offset = 0;
+    for (size_t i = 0; i <= roomCount; ++i)
+    {
+        append(&output, &offset, sizeof(offset));
+    }
+    const Text levelText = {chars, header.roomsX};
+    for (size_t i = 0; i < roomCount; ++i)
+    {
+        offset = output.size;
+        memcpy(output.data + offsetsStart + i * sizeof(offset), &offset, sizeof(offset));
+        compileRoom(&output, &levelText, i / header.roomsX, i % header.roomsX);
+    }
+    offset = output.size;
+    memcpy(output.data + offsetsStart + roomCount * sizeof(offset), &offset, sizeof(offset));
+
+    free(chars);
+    *size = output.size;
+    return output.data;
+}
+
+// Checks the header and the room index, the rooms themselves are checked when they are read
+static int checkFile(LevelFile *file, const char *path)
+{
+    const LevelFileHeader *header = (const LevelFileHeader *)file->data;
+    if (file->size < sizeof(*header) || memcmp(header->magic, LEVEL_FILE_MAGIC, 4) != 0)
+    {
+        fprintf(stderr, "Level: %s is not a level file\n", path);
+        return 0;
+    }
+    if (header->version != LEVEL_FILE_VERSION)
+    {
+        fprintf(stderr, "Level: %s has version %u, the game reads version %d\n", path, header->version, LEVEL_FILE_VERSION);
+        return 0;
+    }
+    const size_t roomCount = (size_t)header->roomsX * header->roomsY;
+    if (roomCount == 0 || header->startRoom >= roomCount || header->startCell >= CELL_COUNT ||
+        (file->size - sizeof(*header)) / sizeof(Uint32) < roomCount + 1)
+    {
+        fprintf(stderr, "Level: %s is damaged\n", path);
+        return 0;
+    }
+    // Every room record lies in the file after the offsets, so rooms can be compared before they are read
+    const Uint32 *offsets = (const Uint32 *)(header + 1);
+    const size_t recordsStart = sizeof(*header) + sizeof(Uint32) * (roomCount + 1);
+    for (size_t room = 0; room < roomCount; ++room)
+    {
+        const Uint32 begin = offsets[room];
+        const Uint32 end = offsets[room + 1];
+        if (begin % 4 || begin < recordsStart || begin > end || end > file->size ||
+            end - begin < sizeof(LevelFileRoom))
+        {
+            fprintf(stderr, "Level: %s is damaged\n", path);
+            return 0;
+        }
+    }
+    file->header = header;
+    file->roomOffsets = offsets;
+    return 1;
+}
+
+// Uses a compiled level file of the asset pack in place, compiles a text one
+static int openPacked(LevelFile *file, const void *data, size_t size, const char *path)
+{
+    if (size >= 4 && memcmp(data, LEVEL_FILE_MAGIC, 4) == 0)
+    {
+        file->data = data;
+        file->size = size;
+        file->packed = 1;
+    }
+    else if (!(file->data = level_compile(data, size, &file->size)))
+    {
+        return 0;
+    }
+    if (!checkFile(file, path))
+    {
+        level_file_close(file);
+        return 0;
+    }
+    return 1;
+}
+
+const void *level_file_find_packed(const char *name, size_t *size)
+{
+    const size_t length = strlen(name);
+    if (length > 4 && length < ASSET_NAME_SIZE && strcmp(name + length - 4, ".txt") == 0)
+    {
+        char compiled[ASSET_NAME_SIZE];
+        memcpy(compiled, name, length - 4);
+        strcpy(compiled + length - 4, ".lvl");
+        const void *data = asset_pack_find(compiled, size);
+        if (data)
+        {
+            return data;
+        }
+    }
+    return asset_pack_find(name, size);
+}
+
+int level_file_open(LevelFile *file, const char *name)
+{
+    memset(file, 0, sizeof(*file));
+    size_t packedSize;
+    const void *packed = level_file_find_packed(name, &packedSize);
+    if (packed)
+    {
+        return openPacked(file, packed, packedSize, name);
+    }
+
+    char path[PATH_MAX];
+    asset_resolve(name, path, sizeof(path));
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        fprintf(stderr, "Level: ");
+        perror(path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return 0;
+    }
+
+    // Compiled files are used in place, the pages of a room are only read when it is built
+    char magic[4] = "";
+    if (read(fd, magic, sizeof(magic)) == sizeof(magic) && memcmp(magic, LEVEL_FILE_MAGIC, 4) == 0)
+    {
+        void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            perror("Level: mmap");
+            return 0;
+        }
+        file->data = data;
+        file->size = info.st_size;
+        file->mapped = 1;
+    }
+    else
+    {
+        char *text = malloc(info.st_size);
+        ensure_condition(text != NULL, "level_file_open(): Out of memory");
+        const ssize_t length = pread(fd, text, info.st_size, 0);
+        close(fd);
+        if (length != info.st_size)
+        {
+            fprintf(stderr, "Level: failed to read %s\n", path);
+            free(text);
+            return 0;
+        }
+        file->data = level_compile(text, length, &file->size);
+        free(text);
+        if (!file->data)
+        {
+            return 0;
+        }
+    }
+
+    if (!checkFile(file, path))
+    {
+        level_file_close(file);
+        return 0;
+    }
+    return 1;
+}
+
+void level_file_close(LevelFile *file)
+{
+    if (file->mapped)
+    {
+        munmap((void *)file->data, file->size);
+    }
+    else if (!file->packed) // Packed data belongs to the asset pack
+    {
+        free((void *)file->data);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+const LevelFileRoom *level_file_room(const LevelFile *file, int room)
+{
+    // checkFile() made sure that the record lies in the file
+    const Uint32 begin = file->roomOffsets[room];
+    const Uint32 end = file->roomOffsets[room + 1];
+    const LevelFileRoom *record = (const LevelFileRoom *)(file->data + begin);
+    if ((end - begin - sizeof(LevelFileRoom)) / sizeof(LevelSpawn) < record->spawnCount)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < CELL_COUNT; ++i)
+    {
+        if (record->cells[i] >= TYPE_COUNT)
+        {
+            return NULL;
+        }
+    }
+    const LevelSpawn *spawns = level_file_spawns(record);
+    for (Uint32 i = 0; i < record->spawnCount; ++i)
+    {
+        if (spawns[i].type >= TYPE_COUNT || spawns[i].cell >= CELL_COUNT)
+        {
+            return NULL;
+        }
+    }
+    return record;
+}
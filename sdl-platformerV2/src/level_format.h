@@ -0,0 +1,73 @@
+#ifndef LEVEL_FORMAT_H
+#define LEVEL_FORMAT_H
+
+#include "types.h"
+
+// Compiled level file, written by sdl_platformer_levelc and mapped by the game
+// as it is. All integers are in the byte order of the machine which compiled
+// it ("make levels" builds them where the game runs), a file of the other byte
+// order fails the version check. Every record starts 4 byte aligned:
+//   LevelFileHeader
+//   Uint32 room offsets[roomsX * roomsY + 1], from the start of the file, the last one is the file size
+//   per room in row major order: LevelFileRoom, then its LevelSpawns
+// The cells already hold the resolved tile variants (tops, pillar parts,
+// spikes, grass, ...), the spawns are the dynamic objects in the order the
+// room creates them. A room only has to be read when it is built.
+
+#define LEVEL_FILE_MAGIC "PLVL"
+enum { LEVEL_FILE_VERSION = 1 };
+
+typedef struct
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 roomsX;
+    Uint32 roomsY;
+    Uint32 startRoom;   // r * roomsX + c of the room with the start position
+    Uint32 startCell;   // r * COLUMN_COUNT + c of the start position in that room
+} LevelFileHeader;
+
+typedef struct
+{
+    Uint32 spawnCount;
+    Uint8 cells[CELL_COUNT]; // Type ids of the static cells, TYPE_NONE for empty ones
+} LevelFileRoom;
+
+typedef struct
+{
+    Uint8 type;     // ObjectTypeId
+    Uint8 data;     // Object data, the character of action objects
+    Uint16 cell;    // r * COLUMN_COUNT + c
+} LevelSpawn;
+
+typedef struct
+{
+    const Uint8 *data;
+    size_t size;
+    int mapped;     // data is mapped from the file
+    int packed;     // data lies in the asset pack, otherwise it was compiled into memory
+    const LevelFileHeader *header;
+    const Uint32 *roomOffsets;
+} LevelFile;
+
+// Maps a compiled level file, or compiles a text level file into memory. The
+// file is taken from the asset pack if it has it, see asset_pack.h.
+// Returns 0 after printing the reason if the file can't be used.
+int level_file_open(LevelFile *file, const char *path);
+// Returns the level in the asset pack, NULL if it isn't there. For a text level
+// "make pack" stores the compiled file, level/X.lvl of level/X.txt, which is preferred.
+const void *level_file_find_packed(const char *name, size_t *size);
+void level_file_close(LevelFile *file);
+// Returns the room, NULL if its record lies outside the file
+const LevelFileRoom *level_file_room(const LevelFile *file, int room);
+static inline const LevelSpawn *level_file_spawns(const LevelFileRoom *room)
+{
+    return (const LevelSpawn *)(room + 1);
+}
+
+// Compiles the text format: optional "#world X Y" and "#legend" header lines
+// (see DEFAULT_LEGEND in level_format.c), then the rooms as rows of characters. Returns the compiled file in memory allocated with malloc(),
+// NULL after printing the reason if the text is invalid.
+Uint8 *level_compile(const char *text, size_t length, size_t *size);
+
+#endif /* LEVEL_FORMAT_H */
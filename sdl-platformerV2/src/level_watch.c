@@ -0,0 +1,62 @@
+#include "level_watch.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static struct {
+    int fd;
+    char name[NAME_MAX + 1];    // File name within the watched directory
+} watch = {-1};
+
+int level_watch_start(const char* path) {
+    char directory[PATH_MAX];
+    const char* slash = strrchr(path, '/');
+    if (slash) {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - path), path);
+    } else {
+        strcpy(directory, ".");
+    }
+    snprintf(watch.name, sizeof(watch.name), "%s", slash ? slash + 1 : path);
+
+    watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch.fd < 0 || inotify_add_watch(watch.fd, directory[0] ? directory : "/", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Level watch: ");
+        perror(directory);
+        level_watch_stop();
+        return 0;
+    }
+    printf("Watching %s for changes\n", path);
+    return 1;
+}
+
+void level_watch_stop(void) {
+    if (watch.fd >= 0) {
+        close(watch.fd);
+        watch.fd = -1;
+    }
+}
+
+int level_watch_changed(void) {
+    if (watch.fd < 0) {
+        return 0;
+    }
+    // An editor's save is often several events, they are all read at once
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t length;
+    while ((length = read(watch.fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            changed |= event->len > 0 && strcmp(event->name, watch.name) == 0;
+            p += sizeof(*event) + event->len;
+        }
+    }
+    if (length < 0 && errno != EAGAIN) {
+        perror("Level watch: read");
+        level_watch_stop();
+    }
+    return changed;
+}
@@ -0,0 +1,15 @@
+#ifndef LEVEL_WATCH_H
+#define LEVEL_WATCH_H
+
+// Development mode: watches the level file with inotify, so the game can
+// reload the rooms a designer edited without restarting. The directory is
+// watched instead of the file, editors and sdl_platformer_levelc replace the
+// file by renaming a new one over it.
+
+// Returns 0 after printing the reason if the file can't be watched
+int level_watch_start(const char* path);
+void level_watch_stop(void);
+// Doesn't block, returns 1 if the file was written or replaced since the last call
+int level_watch_changed(void);
+
+#endif /* LEVEL_WATCH_H */
@@ -2,16 +2,22 @@
 #include "render.h"
 #include "game.h"
 #include "helpers.h"
+#include "options.h"
+#include "objects.h"
+#include "level_format.h"
 #include <SDL2/SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 
 
-Level levels[LEVEL_COUNTY][LEVEL_COUNTX];
+World world;
+int levelCountX = LEVEL_COUNTX;
+int levelCountY = LEVEL_COUNTY;
 const char *levelPath = "level/level1.txt";
-char *levelsString = NULL; // Initialize global pointers to NULL
+static LevelFile levelFile;
 
 
 
@@ -21,7 +27,7 @@ static void changeSprite(ObjectTypeId typeId, int spriteRow, int spriteColumn);
 static void addGraficToSprites(void);
 
 // Level Initialization and Management
-static void initializeLevelsFromString(const char *string);
+static void buildRoom(Level *level, int lr, int lc);
 
 
 static void changeSprite(ObjectTypeId typeId, int spriteRow, int spriteColumn)
@@ -49,335 +55,303 @@ static void addGraficToSprites()
     changeSprite(TYPE_LADDER, 12, 2);
 }
 
-static inline const char *getLevelString(const char *allLevels, int r, int c)
+static inline int isCellSet(const Uint8 *bits, int index)
 {
-    return allLevels + r * CELL_COUNT * LEVEL_COUNTX + c * COLUMN_COUNT;
+    return bits[index / 8] & (1 << index % 8);
 }
 
-static inline const char getLevelChar(const char *levelString, int r, int c)
+static inline void setCell(Uint8 *bits, int index)
 {
-    return levelString[r * COLUMN_COUNT * LEVEL_COUNTX + c];
+    bits[index / 8] |= 1 << index % 8;
 }
 
-static void initializeLevelsFromString(const char *string)
+static RoomState *findRoomState(int room)
 {
-    struct
+    int low = 0, high = world.stateCount;
+    while (low < high)
     {
-        int r, c;
-    } startLevel;
-
-    // Iterate over the levels
-    for (int lr = 0; lr < LEVEL_COUNTY; ++lr)
-    {
-        for (int lc = 0; lc < LEVEL_COUNTX; ++lc)
+        const int middle = (low + high) / 2;
+        if (world.states[middle].room < room)
+        {
+            low = middle + 1;
+        }
+        else
         {
-            const char *levelString = getLevelString(string, lr, lc);
-
-            Level *level = &levels[lr][lc];
-            initializeLevel(level);
-            level->r = lr;
-            level->c = lc;
-            ObjectArray_append(&level->objects, (Object *)&player);
-
-            // Iterate over the level cells and create objects
-            for (int r = 0; r < ROW_COUNT; ++r)
-            {
-                for (int c = 0; c < COLUMN_COUNT; ++c)
-                {
-                    const char s = getLevelChar(levelString, r, c);
-
-                    // Wall and ground
-                    if (s == '*' || s == 'x')
-                    {
-                        const ObjectTypeId type = s == '*' ? TYPE_WALL : TYPE_GROUND;
-                        const ObjectTypeId type_top = s == '*' ? TYPE_WALL_TOP : TYPE_GROUND_TOP;
-                        const char st = getLevelChar(levelString, r - 1, c);
-                        if (r == 0 || st == '*' || st == 'x')
-                        {
-                            createStaticObject(level, type, r, c);
-                        }
-                        else
-                        {
-                            createStaticObject(level, type_top, r, c);
-                        }
-                        // Water
-                    }
-                    else if (s == '~')
-                    {
-                        const char st = getLevelChar(levelString, r - 1, c);
-                        if (r == 0 || st == '~' || st == 'x' || st == '*')
-                        {
-                            createStaticObject(level, TYPE_WATER, r, c);
-                        }
-                        else
-                        {
-                            createDynamicObject(level, TYPE_WATER_TOP, r, c);
-                        }
-                        // Pillar
-                    }
-                    else if (s == '|')
-                    {
-                        const char st = getLevelChar(levelString, r - 1, c);
-                        const char sb = getLevelChar(levelString, r + 1, c);
-                        if (r == 0 || st == '*' || st == 'x')
-                        {
-                            createStaticObject(level, TYPE_PILLAR_TOP, r, c);
-                        }
-                        else if (r == ROW_COUNT - 1 || sb == '*' || sb == 'x')
-                        {
-                            createStaticObject(level, TYPE_PILLAR_BOTTOM, r, c);
-                        }
-                        else
-                        {
-                            createStaticObject(level, TYPE_PILLAR, r, c);
-                        }
-                        // Spike
-                    }
-                    else if (s == '^')
-                    {
-                        const char st = getLevelChar(levelString, r - 1, c);
-                        if (st == '*' || st == 'x')
-                        {
-                            createStaticObject(level, TYPE_SPIKE_TOP, r, c);
-                        }
-                        else
-                        {
-                            createStaticObject(level, TYPE_SPIKE_BOTTOM, r, c);
-                        }
-                        // Other objects
-                    }
-                    else if (s == '-')
-                    {
-                        createStaticObject(level, TYPE_WALL_STAIR, r, c);
-                    }
-                    else if (s == ',')
-                    {
-                        createStaticObject(level, (c + 1) % 3 ? TYPE_GRASS : TYPE_GRASS_BIG, r, c);
-                    }
-                    else if (s == '.')
-                    {
-                        createStaticObject(level, TYPE_MUSHROOM1 + c % 3, r, c);
-                    }
-                    else if (s == ';')
-                    {
-                        createStaticObject(level, c % 2 ? TYPE_TREE1 : TYPE_TREE2, r, c);
-                    }
-                    else if (s == '@')
-                    {
-                        createStaticObject(level, TYPE_ROCK, r, c);
-                    }
-                    else if (s == '=')
-                    {
-                        createStaticObject(level, TYPE_LADDER, r, c);
-                    }
-                    else if (s == 'd')
-                    {
-                        createStaticObject(level, TYPE_DOOR, r, c);
-                    }
-                    else if (s == 'o')
-                    {
-                        createDynamicObject(level, TYPE_COIN, r, c);
-                    }
-                    else if (s == 'O')
-                    {
-                        createDynamicObject(level, TYPE_GEM, r, c);
-                    }
-                    else if (s == 'k')
-                    {
-                        createDynamicObject(level, TYPE_KEY, r, c);
-                    }
-                    else if (s == 'h')
-                    {
-                        createDynamicObject(level, TYPE_HEART, r, c);
-                    }
-                    else if (s == 'a')
-                    {
-                        createDynamicObject(level, TYPE_APPLE, r, c);
-                    }
-                    else if (s == 'i')
-                    {
-                        createDynamicObject(level, TYPE_PEAR, r, c);
-                    }
-                    else if (s == 'S')
-                    {
-                        createDynamicObject(level, TYPE_STATUARY, r, c);
-                    }
-                    else if (s == 'g')
-                    {
-                        createDynamicObject(level, TYPE_GHOST, r, c);
-                    }
-                    else if (s == 's')
-                    {
-                        createDynamicObject(level, TYPE_SCORPION, r, c);
-                    }
-                    else if (s == 'p')
-                    {
-                        createDynamicObject(level, TYPE_SPIDER, r, c);
-                    }
-                    else if (s == 'r')
-                    {
-                        createDynamicObject(level, TYPE_RAT, r, c);
-                    }
-                    else if (s == 'b')
-                    {
-                        createDynamicObject(level, TYPE_BAT, r, c);
-                    }
-                    else if (s == 'q')
-                    {
-                        createDynamicObject(level, TYPE_BLOB, r, c);
-                    }
-                    else if (s == 'f')
-                    {
-                        createDynamicObject(level, TYPE_FIREBALL, r, c);
-                    }
-                    else if (s == 'e')
-                    {
-                        createDynamicObject(level, TYPE_SKELETON, r, c);
-                    }
-                    else if (s == '`')
-                    {
-                        Object *drop = createDynamicObject(level, TYPE_DROP, r, c);
-                        drop->y = (drop->y / CELL_SIZE) * CELL_SIZE - (CELL_SIZE - drop->type->body.h) / 2 - 1;
-                    }
-                    else if (s == '_')
-                    {
-                        createDynamicObject(level, TYPE_PLATFORM, r, c);
-                    }
-                    else if (s == '/')
-                    {
-                        createDynamicObject(level, TYPE_SPRING, r, c);
-                    }
-                    else if (s == '<')
-                    {
-                        createStaticObject(level, TYPE_ARROW_LEFT, r, c);
-                    }
-                    else if (s == '>')
-                    {
-                        createStaticObject(level, TYPE_ARROW_RIGHT, r, c);
-                    }
-                    else if (s == '&')
-                    {
-                        createDynamicObject(level, TYPE_CLOUD1, r, c);
-                    }
-                    else if (s == '!')
-                    {
-                        createDynamicObject(level, TYPE_TORCH, r, c);
-                    }
-                    else if (s >= '1' && s <= '9')
-                    {
-                        Object *action = createDynamicObject(level, TYPE_ACTION, r, c);
-                        action->data = s;
-                        // Start position
-                    }
-                    else if (s == 'P')
-                    {
-                        startLevel.r = lr;
-                        startLevel.c = lc;
-                        player.y = CELL_SIZE * r;
-                        player.x = CELL_SIZE * c;
-                    }
-                }
-            }
-
-            ObjectArray_sortByDepth(&level->objects);
+            high = middle;
         }
     }
-
-    // Set start level
-    setLevel(startLevel.r, startLevel.c);
+    return low < world.stateCount && world.states[low].room == room ? &world.states[low] : NULL;
 }
 
-// Allocates memory and copies characters except newlines
-static char* allocateAndCopyNonNewlineChars(const char* source, long length) {
-    char* processedString = malloc(length + 1);
-    if (!processedString) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return NULL;
+static RoomState *addRoomState(int room)
+{
+    if (world.stateCount == world.stateReserved)
+    {
+        world.stateReserved = world.stateReserved ? world.stateReserved * 2 : 16;
+        world.states = realloc(world.states, sizeof(RoomState) * world.stateReserved);
+        ensure_condition(world.states != NULL, "addRoomState(): Out of memory");
     }
-
-    int j = 0;
-    for (int i = 0; i < length; ++i) {
-        if (source[i] != '\n') {
-            processedString[j++] = source[i];
-        }
+    int i = world.stateCount++;
+    for (; i > 0 && world.states[i - 1].room > room; --i)
+    {
+        world.states[i] = world.states[i - 1];
     }
-    processedString[j] = '\0'; // Null-terminate the processed string
-    return processedString;
+    memset(&world.states[i], 0, sizeof(RoomState));
+    world.states[i].room = room;
+    return &world.states[i];
 }
 
-// Processes the temporary string to remove newlines
-static void processLevelData(char* tempString, long length) {
-    levelsString = allocateAndCopyNonNewlineChars(tempString, length);
-    free(tempString); // Free the temporary string
+void markItemTaken(const Object *item)
+{
+    if (item->origin < 0)
+    {
+        return; // Dropped by the game, not placed by the level file
+    }
+    const int room = level->r * levelCountX + level->c;
+    RoomState *state = findRoomState(room);
+    if (!state)
+    {
+        state = addRoomState(room);
+    }
+    setCell(state->taken, item->origin);
 }
 
-// Function to free the memory allocated for levelsString
-void freeLevelsString()
+// Keeps the doors the player opened, then frees the objects of the room.
+// Taken items are already in the RoomState, the periodic clean may have freed them.
+static void evictRoom(Level *level)
 {
-    free(levelsString);
-    levelsString = NULL;
+    const LevelFileRoom *record = level_file_room(&levelFile, level->r * levelCountX + level->c);
+    for (int i = 0; i < level->objects.count; ++i)
+    {
+        Object *object = level->objects.array[i];
+        if (object != (Object *)&player)
+        {
+            free(object);
+            allocationCounters.objectsFreed += 1;
+        }
+    }
+    level->objects.count = 0;
+    RoomState changes = {0};
+    int changed = 0;
+    for (int i = 0; i < CELL_COUNT; ++i)
+    {
+        if (record->cells[i] == TYPE_DOOR && level->cells[i / COLUMN_COUNT][i % COLUMN_COUNT]->typeId != TYPE_DOOR)
+        {
+            setCell(changes.opened, i);
+            changed = 1;
+        }
+    }
+
+    const int room = level->r * levelCountX + level->c;
+    RoomState *state = findRoomState(room);
+    if (!state && changed)
+    {
+        state = addRoomState(room);
+    }
+    if (state)
+    {
+        memcpy(state->opened, changes.opened, ROOM_STATE_BYTES);
+    }
 }
 
-// Function to load level data from a file
-// Function to load level data from a file
-char* loadLevelFromFile(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Unable to open file %s\n", filename);
-        return NULL;
+Level *getLevel(int r, int c)
+{
+    int victim = -1;
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i)
+    {
+        Level *room = &world.rooms[i];
+        if (world.lastUse[i] && room->r == r && room->c == c)
+        {
+            world.lastUse[i] = ++world.useCount;
+            return room;
+        }
+        if (room != level && (victim < 0 || world.lastUse[i] < world.lastUse[victim]))
+        {
+            victim = i;
+        }
     }
 
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    Level *room = &world.rooms[victim];
+    if (world.lastUse[victim])
+    {
+        evictRoom(room);
+    }
+    buildRoom(room, r, c);
+    world.lastUse[victim] = ++world.useCount;
+    return room;
+}
 
-    char* tempString = malloc(length + 1);
-    if (!tempString) {
-        fclose(file); // Close the file immediately after error
-        return NULL;
+// Creates the objects of the room from the level file, without the items and doors its RoomState removed
+static void buildRoom(Level *level, int lr, int lc)
+{
+    static const RoomState UNCHANGED = {0};
+    const int room = lr * levelCountX + lc;
+    const RoomState *state = findRoomState(room);
+    if (!state)
+    {
+        state = &UNCHANGED;
     }
+    const LevelFileRoom *record = level_file_room(&levelFile, room);
+    ensure_condition(record != NULL, "buildRoom(): The level file is damaged.");
 
-    if (fread(tempString, 1, length, file) < (size_t)length) {
-        fprintf(stderr, "Failed to read the complete file\n");
-        free(tempString);
-        fclose(file);
-        return NULL;
+    for (int i = 0; i < CELL_COUNT; ++i)
+    {
+        const int opened = record->cells[i] == TYPE_DOOR && isCellSet(state->opened, i);
+        level->cells[i / COLUMN_COUNT][i % COLUMN_COUNT] = &objectTypes[opened ? TYPE_NONE : record->cells[i]];
+    }
+    level->initialize = addGraficToSprites;
+    level->r = lr;
+    level->c = lc;
+    rng_seed(&level->rng, options.seed, room);
+    ObjectArray_append(&level->objects, (Object *)&player);
+
+    const LevelSpawn *spawns = level_file_spawns(record);
+    for (Uint32 i = 0; i < record->spawnCount; ++i)
+    {
+        const LevelSpawn *spawn = &spawns[i];
+        if (isCellSet(state->taken, spawn->cell))
+        {
+            continue;
+        }
+        Object *object = createDynamicObject(level, spawn->type, spawn->cell / COLUMN_COUNT, spawn->cell % COLUMN_COUNT);
+        if (spawn->data)
+        {
+            object->data = spawn->data;
+        }
+        object->origin = spawn->cell;
+        if (spawn->type == TYPE_DROP)
+        {
+            object->y = (object->y / CELL_SIZE) * CELL_SIZE - (CELL_SIZE - object->type->body.h) / 2 - 1;
+        }
     }
-    tempString[length] = '\0';
 
-    processLevelData(tempString, length);
-    fclose(file);
-    return levelsString;
+    ObjectArray_sortByDepth(&level->objects);
+}
+
+// Puts the player on the start position of the level file and enters its room
+static void enterStartPosition()
+{
+    const LevelFileHeader *header = levelFile.header;
+    player.y = CELL_SIZE * (header->startCell / COLUMN_COUNT);
+    player.x = CELL_SIZE * (header->startCell % COLUMN_COUNT);
+    setLevel(header->startRoom / levelCountX, header->startRoom % levelCountX);
 }
 
 void initializeLevels()
 {
-    if (!loadLevelFromFile(levelPath))
+    ensure_condition(level_file_open(&levelFile, levelPath), "initializeLevels(): Failed to load the levels.");
+    levelCountX = levelFile.header->roomsX;
+    levelCountY = levelFile.header->roomsY;
+
+    memset(&world, 0, sizeof(world));
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i)
     {
-        fprintf(stderr, "Failed to load levels from file: %s\n", levelPath);
-        return; // Exit if loading fails
+        initializeLevel(&world.rooms[i]);
     }
+    enterStartPosition();
+}
 
-    // ensure levelsString is correctly initialized before proceeding
-    if (levelsString == NULL)
+// Frees the objects of the room, except the player
+static void freeObjects(Level *level)
+{
+    ObjectArray *objects = &level->objects;
+    for (int i = 0; i < objects->count; ++i)
     {
-        fprintf(stderr, "Levels string is not initialized.\n");
-        return;
+        if (objects->array[i] != (Object *)&player)
+        {
+            free(objects->array[i]);
+            allocationCounters.objectsFreed += 1;
+        }
     }
-    // printf("Actual length: %zu\n", strlen(levelsString));
-    // printf("Expected length: %d\n", LEVEL_COUNTY * LEVEL_COUNTX * ROW_COUNT * COLUMN_COUNT);
+    objects->count = 0;
+}
 
-    ensure_condition(strlen(levelsString) == LEVEL_COUNTY * LEVEL_COUNTX * ROW_COUNT * COLUMN_COUNT,
-           "The levels string does not match the levels count or size.");
-           
+static int isRoomChanged(const LevelFile *file, const LevelFile *next, int room)
+{
+    const Uint32 size = file->roomOffsets[room + 1] - file->roomOffsets[room];
+    return size != next->roomOffsets[room + 1] - next->roomOffsets[room] ||
+           memcmp(file->data + file->roomOffsets[room], next->data + next->roomOffsets[room], size) != 0;
+}
 
-    initializeLevelsFromString(levelsString);
+int reloadLevels()
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    LevelFile next;
+    if (!level_file_open(&next, levelPath))
+    {
+        return -1;
+    }
+    if ((int)next.header->roomsX != levelCountX || (int)next.header->roomsY != levelCountY)
+    {
+        fprintf(stderr, "Level: the world size changed, restart the game to load %s\n", levelPath);
+        level_file_close(&next);
+        return -1;
+    }
+
+    const int roomCount = levelCountX * levelCountY;
+    Uint8 *changed = calloc(roomCount, 1);
+    ensure_condition(changed != NULL, "reloadLevels(): Out of memory");
+    int changedCount = 0;
+    for (int room = 0; room < roomCount; ++room)
+    {
+        if (!isRoomChanged(&levelFile, &next, room))
+        {
+            continue;
+        }
+        if (!level_file_room(&next, room))
+        {
+            fprintf(stderr, "Level: room %d of %s is damaged\n", room, levelPath);
+            level_file_close(&next);
+            free(changed);
+            return -1;
+        }
+        changed[room] = 1;
+        changedCount += 1;
+    }
+    level_file_close(&levelFile);
+    levelFile = next;
+
+    // What the player changed in an edited room may not fit its new content
+    int kept = 0;
+    for (int i = 0; i < world.stateCount; ++i)
+    {
+        if (!changed[world.states[i].room])
+        {
+            world.states[kept++] = world.states[i];
+        }
+    }
+    world.stateCount = kept;
 
-    for (int r = 0; r < LEVEL_COUNTY; r++)
+    // The other rooms in the cache are built when they are used
+    int rebuilt = 0;
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i)
     {
-        for (int c = 0; c < LEVEL_COUNTX; c++)
+        Level *room = &world.rooms[i];
+        if (world.lastUse[i] && changed[room->r * levelCountX + room->c])
         {
-            levels[r][c].initialize = addGraficToSprites;
+            freeObjects(room);
+            buildRoom(room, room->r, room->c);
+            rebuilt += 1;
         }
     }
+    free(changed);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double time = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    printf("Level: %d of %d rooms changed, %d rebuilt in %.2f ms\n", changedCount, roomCount, rebuilt, time);
+    return changedCount;
+}
+
+void freeLevels()
+{
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i)
+    {
+        freeObjects(&world.rooms[i]);
+        ObjectArray_free(&world.rooms[i].objects);
+    }
+    free(world.states);
+    memset(&world, 0, sizeof(world));
+    level = NULL;
+    level_file_close(&levelFile);
 }
\ No newline at end of file
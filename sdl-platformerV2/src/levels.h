@@ -3,15 +3,58 @@
 
 #include "types.h"
 
+// Default world size, text level files can override it with a "#world X Y" header line
 enum
 {
     LEVEL_COUNTX = 2,
     LEVEL_COUNTY = 2
 };
 
-extern Level levels[LEVEL_COUNTY][LEVEL_COUNTX];
+// Rooms are instantiated from the level file when getLevel() first asks for
+// them, usually because the player approaches their border. At most
+// LEVEL_CACHE_SIZE rooms exist at a time, the least recently used one is
+// evicted for the next. What the player changed for good in an evicted room
+// is kept as a RoomState, everything else starts over when it comes back.
+// Collected items are written to the RoomState as they are taken, opened
+// doors when the room is evicted.
+enum
+{
+    LEVEL_CACHE_SIZE = 16,
+    ROOM_STATE_BYTES = (CELL_COUNT + 7) / 8
+};
+
+// One bit per cell, in row major order
+typedef struct
+{
+    int room;                       // r * levelCountX + c
+    Uint8 taken[ROOM_STATE_BYTES];  // Items collected, by the cell the level file placed them at
+    Uint8 opened[ROOM_STATE_BYTES]; // Doors opened
+} RoomState;
+
+typedef struct
+{
+    Level rooms[LEVEL_CACHE_SIZE];
+    unsigned long lastUse[LEVEL_CACHE_SIZE]; // 0 for a free slot
+    unsigned long useCount;
+    RoomState *states;  // Rooms with changes, sorted by room
+    int stateCount;
+    int stateReserved;
+} World;
+
+extern World world;
+extern int levelCountX;
+extern int levelCountY;
+extern const char* levelPath;
 
 void initializeLevels();
-char* loadLevelFromFile(const char* filename);
+void freeLevels();
+// The room stays valid until LEVEL_CACHE_SIZE other rooms were used after it. The current level is never evicted.
+Level* getLevel(int r, int c);
+// Keeps the item of the current level from coming back when its room is built again
+void markItemTaken(const Object *item);
+// Reads the level file again and rebuilds the rooms in the cache whose content
+// changed, the player stays where it is. Returns the number of changed rooms,
+// -1 after printing the reason if the file can't be used (the old one stays).
+int reloadLevels();
 
-#endif
\ No newline at end of file
+#endif
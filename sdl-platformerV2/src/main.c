@@ -1,7 +1,9 @@
 #include "game.h"
+#include "options.h"
 
 int main( int argc, char* argv[] )
 {
+    options_parse(argc, argv);
     initializeGame();
     handleGameLoop();
     return 0;
@@ -0,0 +1,482 @@
+#include "net.h"
+#include "rng.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Packet layout, all integers big endian:
+//   Uint32 magic "PLNT", Uint8 type, Uint8 input count, Sint16 frame advantage,
+//   Uint32 seed (WELCOME) or tick of the first input (INPUT),
+//   Uint32 newest confirmed tick of the receiver's inputs + 1 (0 for none),
+//   Uint32 next tick of the sender, Uint32 checksum tick + 1 (0 for none),
+//   Uint32 checksum, Uint8 inputs[count]
+static const Uint32 NET_MAGIC = 0x504C4E54;
+
+enum {
+    HEADER_SIZE = 28,
+    MAX_PACKET_INPUTS = NET_WINDOW / 2,
+    MAX_PACKET_SIZE = HEADER_SIZE + MAX_PACKET_INPUTS,
+    CONNECT_RETRY_MS = 100,
+    CONNECT_RETRIES = 300,  // 30 seconds
+    WAIT_INTERVAL = 10,     // Ticks between two waits for the peer
+    BYE_COUNT = 3           // Sent several times as they are not acknowledged
+};
+
+typedef enum {
+    PACKET_HELLO = 1,
+    PACKET_WELCOME,
+    PACKET_INPUT,
+    PACKET_BYE
+} PacketType;
+
+typedef struct {
+    PacketType type;
+    int count;
+    int advantage;
+    Uint32 first;   // Seed in WELCOME packets
+    Uint32 ack;
+    Uint32 tick;
+    Uint32 checksum_tick;
+    Uint32 checksum;
+    Uint8 inputs[MAX_PACKET_INPUTS];
+} Packet;
+
+static struct {
+    int socket;             // -1 while not connected
+    int slot;
+    Uint32 seed;
+    int peer_left;
+    int loss;               // Percent of the input packets to drop
+    Rng rng;
+
+    // Local inputs up to local_newest, the peer confirmed them up to ack
+    Uint8 local[NET_WINDOW];
+    int local_newest;
+    int ack;
+
+    // Remote inputs, an entry is valid if its tag is the tick
+    Uint8 remote[NET_WINDOW];
+    int remote_tag[NET_WINDOW];
+    int confirmed;          // All remote inputs up to this tick have arrived
+    Uint8 predicted[NET_WINDOW];
+    int predicted_tag[NET_WINDOW];
+    int rollback;
+
+    // Frame advantage, see net_should_wait()
+    int remote_tick;
+    int remote_advantage;
+    int last_wait_tick;
+
+    Uint32 local_checksum[NET_WINDOW];
+    int local_checksum_tag[NET_WINDOW];
+    Uint32 remote_checksum[NET_WINDOW];
+    int remote_checksum_tag[NET_WINDOW];
+    int newest_checksum;
+
+    NetStats stats;
+} net = {.socket = -1};
+
+static void reset(int slot, Uint32 seed) {
+    const int socket = net.socket;
+    const int loss = net.loss;
+    memset(&net, 0, sizeof(net));
+    net.socket = socket;
+    net.loss = loss;
+    net.slot = slot;
+    net.seed = seed;
+    rng_seed(&net.rng, seed, slot);
+    net.local_newest = -1;
+    net.ack = -1;
+    net.confirmed = -1;
+    net.rollback = -1;
+    net.last_wait_tick = -WAIT_INTERVAL;
+    net.newest_checksum = -1;
+    for (int i = 0; i < NET_WINDOW; ++i) {
+        net.remote_tag[i] = -1;
+        net.predicted_tag[i] = -1;
+        net.local_checksum_tag[i] = -1;
+        net.remote_checksum_tag[i] = -1;
+    }
+    net.stats.desync_tick = -1;
+}
+
+static void put_u32(Uint8* p, Uint32 value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static Uint32 get_u32(const Uint8* p) {
+    return (Uint32)p[0] << 24 | (Uint32)p[1] << 16 | (Uint32)p[2] << 8 | p[3];
+}
+
+static void send_packet(const Packet* packet) {
+    if (packet->type == PACKET_INPUT && net.loss && rng_range(&net.rng, 100) < net.loss) {
+        net.stats.packets_dropped += 1;
+        return;
+    }
+    Uint8 buffer[MAX_PACKET_SIZE];
+    put_u32(buffer, NET_MAGIC);
+    buffer[4] = packet->type;
+    buffer[5] = packet->count;
+    buffer[6] = (Uint16)packet->advantage >> 8;
+    buffer[7] = (Uint16)packet->advantage;
+    put_u32(buffer + 8, packet->first);
+    put_u32(buffer + 12, packet->ack);
+    put_u32(buffer + 16, packet->tick);
+    put_u32(buffer + 20, packet->checksum_tick);
+    put_u32(buffer + 24, packet->checksum);
+    memcpy(buffer + HEADER_SIZE, packet->inputs, packet->count);
+
+    // The socket is connected to the peer. Errors, e.g. while the peer isn't
+    // listening yet, are handled like lost packets.
+    if (send(net.socket, buffer, HEADER_SIZE + packet->count, MSG_DONTWAIT) >= 0) {
+        net.stats.packets_sent += 1;
+    }
+}
+
+static void send_simple(PacketType type, Uint32 first) {
+    Packet packet = {0};
+    packet.type = type;
+    packet.first = first;
+    send_packet(&packet);
+}
+
+// Returns 0 if nothing valid was received
+static int receive_packet(int socket, Packet* packet, struct sockaddr_in* from) {
+    Uint8 buffer[MAX_PACKET_SIZE];
+    socklen_t length = sizeof(*from);
+    const ssize_t size = recvfrom(socket, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)from, &length);
+    if (size < HEADER_SIZE || get_u32(buffer) != NET_MAGIC) {
+        return 0;
+    }
+    packet->type = buffer[4];
+    packet->count = buffer[5];
+    packet->advantage = (Sint16)(buffer[6] << 8 | buffer[7]);
+    packet->first = get_u32(buffer + 8);
+    packet->ack = get_u32(buffer + 12);
+    packet->tick = get_u32(buffer + 16);
+    packet->checksum_tick = get_u32(buffer + 20);
+    packet->checksum = get_u32(buffer + 24);
+    if (packet->count > MAX_PACKET_INPUTS || size != HEADER_SIZE + packet->count) {
+        return 0;
+    }
+    memcpy(packet->inputs, buffer + HEADER_SIZE, packet->count);
+    return 1;
+}
+
+// Waits up to CONNECT_RETRY_MS for a packet
+static int wait_for_packet(int socket, Packet* packet, struct sockaddr_in* from) {
+    struct pollfd fd = {socket, POLLIN, 0};
+    if (poll(&fd, 1, CONNECT_RETRY_MS) <= 0) {
+        return 0;
+    }
+    return receive_packet(socket, packet, from);
+}
+
+int net_host(int port, Uint32* seed) {
+    const int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0) {
+        perror("net_host(): socket");
+        return 0;
+    }
+    const int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(s, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        perror("net_host(): bind");
+        close(s);
+        return 0;
+    }
+
+    printf("Waiting for a player on port %d\n", port);
+    for (int i = 0; i < CONNECT_RETRIES; ++i) {
+        Packet packet;
+        struct sockaddr_in from;
+        if (wait_for_packet(s, &packet, &from) && packet.type == PACKET_HELLO &&
+            connect(s, (struct sockaddr*)&from, sizeof(from)) == 0) {
+            net.socket = s;
+            reset(0, *seed);
+            send_simple(PACKET_WELCOME, *seed);
+            printf("Player joined from %s\n", inet_ntoa(from.sin_addr));
+            return 1;
+        }
+    }
+    fprintf(stderr, "net_host(): Nobody joined\n");
+    close(s);
+    return 0;
+}
+
+int net_join(const char* address, Uint32* seed) {
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (!colon || colon == address || (size_t)(colon - address) >= sizeof(host)) {
+        fprintf(stderr, "net_join(): Expected HOST:PORT, got %s\n", address);
+        return 0;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+
+    struct addrinfo hints, *info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    const int error = getaddrinfo(host, colon + 1, &hints, &info);
+    if (error) {
+        fprintf(stderr, "net_join(): %s: %s\n", address, gai_strerror(error));
+        return 0;
+    }
+    const int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0 || connect(s, info->ai_addr, info->ai_addrlen) < 0) {
+        perror("net_join(): connect");
+        freeaddrinfo(info);
+        if (s >= 0) {
+            close(s);
+        }
+        return 0;
+    }
+    freeaddrinfo(info);
+
+    net.socket = s;
+    printf("Joining %s\n", address);
+    for (int i = 0; i < CONNECT_RETRIES; ++i) {
+        send_simple(PACKET_HELLO, 0);
+        Packet packet;
+        struct sockaddr_in from;
+        if (wait_for_packet(s, &packet, &from) && packet.type == PACKET_WELCOME) {
+            *seed = packet.first;
+            reset(1, *seed);
+            return 1;
+        }
+    }
+    fprintf(stderr, "net_join(): The host didn't answer\n");
+    net.socket = -1;
+    close(s);
+    return 0;
+}
+
+void net_shutdown(void) {
+    if (net.socket < 0) {
+        return;
+    }
+    for (int i = 0; i < BYE_COUNT; ++i) {
+        send_simple(PACKET_BYE, 0);
+    }
+    close(net.socket);
+    net.socket = -1;
+}
+
+int net_is_active(void) {
+    return net.socket >= 0;
+}
+
+int net_get_local_slot(void) {
+    return net.slot;
+}
+
+int net_peer_left(void) {
+    return net.peer_left;
+}
+
+void net_set_packet_loss(int percent) {
+    net.loss = percent < 0 ? 0 : percent > 100 ? 100 : percent;
+}
+
+static void compare_checksums(int tick) {
+    const int i = tick & (NET_WINDOW - 1);
+    if (net.local_checksum_tag[i] != tick || net.remote_checksum_tag[i] != tick) {
+        return;
+    }
+    net.stats.checksums_compared += 1;
+    if (net.local_checksum[i] != net.remote_checksum[i] && net.stats.desync_tick < 0) {
+        net.stats.desync_tick = tick;
+        fprintf(stderr, "Desync at tick %d: local checksum %08x, remote %08x\n",
+                tick, (unsigned)net.local_checksum[i], (unsigned)net.remote_checksum[i]);
+    }
+}
+
+static void receive_input(const Packet* packet) {
+    if ((int)packet->tick > net.remote_tick) {
+        net.remote_tick = packet->tick;
+        net.remote_advantage = packet->advantage;
+    }
+    if ((int)packet->ack - 1 > net.ack) {
+        net.ack = packet->ack - 1;
+    }
+
+    for (int k = 0; k < packet->count; ++k) {
+        const int tick = packet->first + k;
+        const int i = tick & (NET_WINDOW - 1);
+        // Older ticks are known, much newer ones would overwrite entries still in use
+        if (tick <= net.confirmed || tick > net.confirmed + MAX_PACKET_INPUTS || net.remote_tag[i] == tick) {
+            continue;
+        }
+        net.remote[i] = packet->inputs[k];
+        net.remote_tag[i] = tick;
+        if (net.predicted_tag[i] == tick && net.predicted[i] != packet->inputs[k] &&
+            (net.rollback < 0 || tick < net.rollback)) {
+            net.rollback = tick;
+        }
+    }
+    while (net.remote_tag[(net.confirmed + 1) & (NET_WINDOW - 1)] == net.confirmed + 1) {
+        net.confirmed += 1;
+    }
+
+    if (packet->checksum_tick) {
+        const int tick = packet->checksum_tick - 1;
+        const int i = tick & (NET_WINDOW - 1);
+        net.remote_checksum[i] = packet->checksum;
+        net.remote_checksum_tag[i] = tick;
+        compare_checksums(tick);
+    }
+}
+
+void net_poll(void) {
+    if (net.socket < 0) {
+        return;
+    }
+    Packet packet;
+    struct sockaddr_in from;
+    while (receive_packet(net.socket, &packet, &from)) {
+        net.stats.packets_received += 1;
+        switch (packet.type) {
+            case PACKET_HELLO:
+                // The client didn't get the welcome
+                if (net.slot == 0) {
+                    send_simple(PACKET_WELCOME, net.seed);
+                }
+                break;
+            case PACKET_INPUT:
+                receive_input(&packet);
+                break;
+            case PACKET_BYE:
+                net.peer_left = 1;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void net_send(int tick) {
+    if (net.socket < 0) {
+        return;
+    }
+    Packet packet = {0};
+    packet.type = PACKET_INPUT;
+    int first = net.ack + 1;
+    if (first < net.local_newest - MAX_PACKET_INPUTS + 1) {
+        first = net.local_newest - MAX_PACKET_INPUTS + 1;
+    }
+    packet.first = first;
+    packet.count = net.local_newest - first + 1;
+    for (int k = 0; k < packet.count; ++k) {
+        packet.inputs[k] = net.local[(first + k) & (NET_WINDOW - 1)];
+    }
+    packet.advantage = tick - net.remote_tick;
+    packet.ack = net.confirmed + 1;
+    packet.tick = tick;
+    if (net.newest_checksum >= 0) {
+        packet.checksum_tick = net.newest_checksum + 1;
+        packet.checksum = net.local_checksum[net.newest_checksum & (NET_WINDOW - 1)];
+    }
+    send_packet(&packet);
+}
+
+void net_set_local_input(int tick, Uint8 input) {
+    while (net.local_newest < tick) {
+        net.local[++net.local_newest & (NET_WINDOW - 1)] = 0;
+    }
+    net.local[tick & (NET_WINDOW - 1)] = input;
+}
+
+int net_has_local_input(int tick) {
+    return tick <= net.local_newest;
+}
+
+Uint8 net_get_input(int slot, int tick) {
+    const int i = tick & (NET_WINDOW - 1);
+    if (slot == net.slot) {
+        return net.local[i];
+    }
+    if (net.remote_tag[i] == tick) {
+        return net.remote[i];
+    }
+    // Predict that the peer keeps holding the same buttons
+    const Uint8 prediction = net.confirmed >= 0 ? net.remote[net.confirmed & (NET_WINDOW - 1)] : 0;
+    net.predicted[i] = prediction;
+    net.predicted_tag[i] = tick;
+    return prediction;
+}
+
+int net_get_confirmed_tick(void) {
+    return net.confirmed;
+}
+
+int net_take_rollback_tick(void) {
+    const int tick = net.rollback;
+    net.rollback = -1;
+    return tick;
+}
+
+// Both sides compute their advantage over the other from the tick in its
+// newest packet. The network delay is in both numbers, so half of their
+// difference is how far this side is really ahead.
+int net_should_wait(int tick) {
+    const int advantage = (tick - net.remote_tick - net.remote_advantage) / 2;
+    if (advantage >= 1 && tick - net.last_wait_tick >= WAIT_INTERVAL) {
+        net.last_wait_tick = tick;
+        return 1;
+    }
+    return 0;
+}
+
+void net_record_checksum(int tick, Uint32 checksum) {
+    const int i = tick & (NET_WINDOW - 1);
+    net.local_checksum[i] = checksum;
+    net.local_checksum_tag[i] = tick;
+    if (tick > net.newest_checksum) {
+        net.newest_checksum = tick;
+    }
+    compare_checksums(tick);
+}
+
+void net_count_rollback(int ticks) {
+    net.stats.rollbacks += 1;
+    net.stats.resimulated_ticks += ticks;
+    if (ticks > net.stats.max_rollback) {
+        net.stats.max_rollback = ticks;
+    }
+}
+
+void net_count_stall(void) {
+    net.stats.stalls += 1;
+}
+
+void net_get_stats(NetStats* stats) {
+    *stats = net.stats;
+}
+
+void net_print_stats(void) {
+    const NetStats* s = &net.stats;
+    printf("Net: %lu packets sent, %lu received, %lu dropped on purpose\n",
+           s->packets_sent, s->packets_received, s->packets_dropped);
+    printf("Net: %lu rollbacks, %lu ticks simulated again, longest %d ticks, %lu stalls\n",
+           s->rollbacks, s->resimulated_ticks, s->max_rollback, s->stalls);
+    if (s->desync_tick < 0) {
+        printf("Net: %lu checksums compared, no desync\n", s->checksums_compared);
+    } else {
+        printf("Net: %lu checksums compared, desync at tick %d\n", s->checksums_compared, s->desync_tick);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef NET_H
+#define NET_H
+
+#include <SDL2/SDL.h>
+
+// Rollback networking for two players over UDP. Both sides simulate every tick
+// right away and predict the missing remote input as the last one received.
+// Each packet repeats all local inputs the peer hasn't acknowledged yet, so a
+// lost packet costs no round trip. When an input arrives which differs from
+// the prediction, the game rolls back to the snapshot before that tick and
+// simulates the ticks up to the present again. Both sides exchange checksums
+// of the ticks whose inputs are confirmed to detect desyncs.
+
+enum {
+    NET_PLAYER_COUNT = 2,
+    NET_MAX_ROLLBACK = 8,   // Ticks a side may simulate ahead of the confirmed remote input
+    NET_MAX_DELAY = 8,      // Maximum local input delay in ticks
+    NET_WINDOW = 64         // Ticks of input and checksum history, power of two
+};
+
+typedef struct {
+    unsigned long packets_sent;
+    unsigned long packets_received;
+    unsigned long packets_dropped;      // Dropped on purpose, see net_set_packet_loss()
+    unsigned long rollbacks;
+    unsigned long resimulated_ticks;
+    int max_rollback;                   // Ticks
+    unsigned long stalls;               // Frames without a tick, waiting for the peer
+    unsigned long checksums_compared;
+    int desync_tick;                    // First tick whose checksums differ, -1 if none
+} NetStats;
+
+// Both block until the peer answers or a timeout. The host sends its seed, the
+// client receives it. Return 0 on failure.
+int net_host(int port, Uint32* seed);
+int net_join(const char* address, Uint32* seed); // HOST:PORT
+void net_shutdown(void);                         // Tells the peer we left
+int net_is_active(void);
+int net_get_local_slot(void);                    // 0 for the host, 1 for the client
+int net_peer_left(void);
+void net_set_packet_loss(int percent);           // Drops outgoing packets on purpose, for testing
+
+void net_poll(void);                             // Receives all pending packets
+void net_send(int tick);                         // Sends the unacknowledged inputs, tick is the next one to simulate
+void net_set_local_input(int tick, Uint8 input); // Ticks must be set in order, skipped ones get no input
+Uint8 net_get_input(int slot, int tick);         // Local, confirmed remote or predicted remote input
+int net_has_local_input(int tick);
+int net_get_confirmed_tick(void);                // Newest tick with confirmed remote input, -1 if none
+int net_take_rollback_tick(void);                // Oldest mispredicted tick since the last call, -1 if none
+int net_should_wait(int tick);                   // 1 if this side should skip a tick to let the peer catch up
+
+void net_record_checksum(int tick, Uint32 checksum); // State after a confirmed tick, compared with the peer's
+void net_count_rollback(int ticks);
+void net_count_stall(void);
+void net_get_stats(NetStats* stats);
+void net_print_stats(void);
+
+#endif /* NET_H */
@@ -4,6 +4,7 @@
 #include "levels.h"
 #include "game.h"
 #include "frame_control.h"
+#include "audio.h"
 #include <math.h>
 
 
@@ -156,9 +157,9 @@ static const int ENEMY_WAITING = 12000;
 
 void MovingEnemy_onInit( Object* e )
 {
-    const int dir = rand() % 2 ? 1 : -1;
+    const int dir = rng_range(&e->rng, 2) ? 1 : -1;
     setSpeed(e, e->type->speed * dir, 0);
-    e->state = -rand() % ENEMY_MOVING;
+    e->state = -rng_range(&e->rng, ENEMY_MOVING);
 }
 
 void MovingEnemy_onFrame( Object* e )
@@ -173,8 +174,8 @@ void MovingEnemy_onFrame( Object* e )
         setAnimation(e, 2, 2, 0);
 
     } else {
-        e->state = ENEMY_MOVING - rand() % (ENEMY_MOVING * 2);
-        if (rand() % 2) {
+        e->state = ENEMY_MOVING - rng_range(&e->rng, ENEMY_MOVING * 2);
+        if (rng_range(&e->rng, 2)) {
             setSpeed(e, -e->vx, e->vy);
         }
     }
@@ -209,6 +210,7 @@ void ShootingEnemy_onFrame( Object* e )
             shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - shot->type->sprite.w : e->x + e->type->sprite.w;
             shot->y = e->y;
             setSpeed(shot, shot->vx * (e->vx > 0 ? 1 : -1), shot->vy);
+            audio_play(SOUND_SHOT, 0.5f);
             e->state = SHOOTINGENEMY_MOVING + 1;
         } else if (move(e, objects_hit_test_ALL)) {
             setSpeed(e, -e->vx, e->vy);
@@ -312,10 +314,13 @@ void Item_onHit( Object* item )
 
         if (general_type_id == TYPE_COIN) {
             player.coins += 1;
+            audio_play(SOUND_COIN, 0.6f);
         } else if (general_type_id == TYPE_KEY) {
             player.keys += 1;
+            audio_play(SOUND_KEY, 0.8f);
         } else if (general_type_id == TYPE_HEART) {
             player.lives += 1;
+            audio_play(SOUND_HEART, 0.8f);
         } else if (general_type_id == TYPE_STATUARY) {
             completeLevel();
         } else {
@@ -323,6 +328,7 @@ void Item_onHit( Object* item )
         }
 
         item->state = ITEM_IDLE + 1;
+        markItemTaken(item);
         setSpeed(item, item->vx, -7 * 24);
         setAnimation(item, 0, 0, 0);
     }
@@ -367,6 +373,7 @@ void Fireball_onFrame( Object* e )
             shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - shot->type->sprite.w : e->x + e->type->sprite.w;
             shot->y = e->y + 2;
             setSpeed(shot, shot->vx * (e->vx > 0 ? 1 : -1), shot->vy);
+            audio_play(SOUND_SHOT, 0.5f);
             e->state = FIREBALL_MOVING + 1;
         }
         setAnimation(e, 0, 1, 2);
@@ -389,10 +396,10 @@ void Fireball_onFrame( Object* e )
     const int dt = frame_control_get_elapsed_frame_time();
     e->data -= dt;
     if (e->data < 0) {
-        if (rand() % 10 == 9) {
+        if (rng_range(&e->rng, 10) == 9) {
             setSpeed(e, -e->vx, e->vy);
         }
-        if (rand() % 10 == 9) {
+        if (rng_range(&e->rng, 10) == 9) {
             setSpeed(e, e->vx, -e->vy);
         }
         e->data = 1000;
@@ -410,7 +417,7 @@ static const int DROP_FELL = 5000;
 
 void Drop_onInit( Object* e )
 {
-    e->state = -rand() % 2000;
+    e->state = -rng_range(&e->rng, 2000);
 }
 
 void Drop_onFrame( Object* e )
@@ -426,7 +433,7 @@ void Drop_onFrame( Object* e )
         drop->x = e->x;
         drop->y = e->y;
         drop->state = DROP_FALLING;
-        e->state = DROP_WAITING - 2000 - rand() % 8000;
+        e->state = DROP_WAITING - 2000 - rng_range(&e->rng, 8000);
 
     } else if (e->state <= DROP_FALLING) {
         if (e->vy < 120) {
@@ -462,7 +469,7 @@ void Spider_onFrame( Object* e )
 {
     MovingEnemy_onFrame(e);
 
-    if (rand() % 100 == 99) {
+    if (rng_range(&e->rng, 100) == 99) {
         const int direction = e->vx > 0 ? 1 : -1;
         if (fabs(e->vx) == e->type->speed) {
             setSpeed(e, direction * e->type->speed * 2.5, e->vy);
@@ -496,8 +503,8 @@ void TeleportingEnemy_onFrame( Object* e )
     } else if (e->state <= TELEPORTINGENEMY_TELEPORT) {
         const int currentRow = (e->y + CELL_HALF) / CELL_SIZE;
         for (int i = 0; i < CELL_COUNT; i++) {
-            const int r = rand() % (ROW_COUNT - 1);
-            const int c = rand() % COLUMN_COUNT;
+            const int r = rng_range(&e->rng, ROW_COUNT - 1);
+            const int c = rng_range(&e->rng, COLUMN_COUNT);
             if (r == currentRow) {
                 continue;
             }
@@ -520,7 +527,7 @@ void TeleportingEnemy_onFrame( Object* e )
         }
 
     } else {
-        e->state = -rand() % 2000;
+        e->state = -rng_range(&e->rng, 2000);
         e->anim.alpha = 255;
     }
 
@@ -601,6 +608,7 @@ void Spring_onHit( Object* e )
     if (e->state == 0 && player.vy > 48) {
         player.vy = -15 * 24;
         e->state = 1000;
+        audio_play(SOUND_SPRING, 0.7f);
         setAnimation(e, 1, 1, 0);
     }
 }
@@ -0,0 +1,157 @@
+#include "options.h"
+#include "levels.h"
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+GameOptions options;
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --seed N            master seed of the random generators (default: time based)\n");
+    printf("  --level FILE        level file to play (default: level/level1.txt)\n");
+    printf("  --record FILE       record input and frame times to FILE\n");
+    printf("  --replay FILE       play a recording back instead of reading input\n");
+    printf("  --profile           show the frame profiler overlay (toggle with F3)\n");
+    printf("  --profile-csv FILE  write per-phase frame times to FILE on exit\n");
+    printf("  --haptics PIN       gpio, file:PATH or off (default: gpio with GPIO input)\n");
+    printf("  --mute              run without audio\n");
+    printf("  --input BACKEND     gpio, keyboard or sim:FILE (default: gpio if available, else keyboard)\n");
+    printf("  --pacing MODE       frame pacing: sleep (default), legacy or vsync\n");
+    printf("  --pacing-stats SEC  print frame pacing statistics every SEC seconds and on exit\n");
+    printf("  --low-latency       read input after the frame wait and present right after simulating\n");
+    printf("  --latency           print the input-to-present latency on exit\n");
+    printf("  --host PORT         host a two-player versus match on the UDP port\n");
+    printf("  --join HOST:PORT    join a versus match\n");
+    printf("  --net-delay TICKS   local input delay in versus matches, 0 to %d (default: 1)\n", NET_MAX_DELAY);
+    printf("  --net-loss PERCENT  drop outgoing packets on purpose, for testing\n");
+    printf("  --spectate ADDRESS  stream the game to a viewer at unix:PATH or HOST:PORT (UDP)\n");
+    printf("  --telemetry NAME    export live counters to the shared memory segment NAME, e.g. /sdl_platformer\n");
+    printf("  --bot PATH          wait for a bot on the UNIX socket PATH, which steps the game and holds the buttons\n");
+    printf("  --watch-level       reload the edited rooms whenever the level file changes\n");
+    printf("  --rewind SEC        keep SEC seconds of history, hold up after a death to rewind\n");
+    printf("  --render-cache FILE cache of the converted textures, or off (default: render.cache)\n");
+    printf("  --pack FILE         asset pack to load from, or off for the loose files (default: assets.pack if built)\n");
+    printf("  --help              show this help\n");
+}
+
+// Returns the value of an option which requires one, exits if it is missing
+static const char* option_value(int argc, char* argv[], int* i) {
+    if (*i + 1 >= argc) {
+        fprintf(stderr, "Option %s requires a value\n", argv[*i]);
+        exit(EXIT_FAILURE);
+    }
+    return argv[++*i];
+}
+
+void options_parse(int argc, char* argv[]) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    options.seed = (unsigned int)(time(NULL) ^ t.tv_nsec);
+    options.net_delay = 1;
+    options.render_cache = "render.cache";
+    options.asset_pack = "assets.pack";
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = strtoul(option_value(argc, argv, &i), NULL, 0);
+        } else if (strcmp(argv[i], "--level") == 0) {
+            levelPath = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--record") == 0) {
+            options.record_path = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            options.replay_path = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            options.profile = 1;
+        } else if (strcmp(argv[i], "--profile-csv") == 0) {
+            options.profile_csv_path = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--haptics") == 0) {
+            options.haptics = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--mute") == 0) {
+            options.mute = 1;
+        } else if (strcmp(argv[i], "--input") == 0) {
+            options.input = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--pacing") == 0) {
+            const char* mode = option_value(argc, argv, &i);
+            if (strcmp(mode, "sleep") == 0) {
+                options.pacing = PACING_SLEEP;
+            } else if (strcmp(mode, "legacy") == 0) {
+                options.pacing = PACING_LEGACY;
+            } else if (strcmp(mode, "vsync") == 0) {
+                options.pacing = PACING_VSYNC;
+            } else {
+                fprintf(stderr, "Unknown pacing mode %s\n", mode);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--pacing-stats") == 0) {
+            options.pacing_stats_interval = strtod(option_value(argc, argv, &i), NULL);
+        } else if (strcmp(argv[i], "--low-latency") == 0) {
+            options.low_latency = 1;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            options.latency = 1;
+        } else if (strcmp(argv[i], "--host") == 0) {
+            options.net_host_port = strtol(option_value(argc, argv, &i), NULL, 0);
+        } else if (strcmp(argv[i], "--join") == 0) {
+            options.net_join_address = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--net-delay") == 0) {
+            options.net_delay = strtol(option_value(argc, argv, &i), NULL, 0);
+            if (options.net_delay < 0 || options.net_delay > NET_MAX_DELAY) {
+                fprintf(stderr, "The input delay must be between 0 and %d ticks\n", NET_MAX_DELAY);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--net-loss") == 0) {
+            options.net_loss = strtol(option_value(argc, argv, &i), NULL, 0);
+        } else if (strcmp(argv[i], "--spectate") == 0) {
+            options.spectate_address = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--telemetry") == 0) {
+            options.telemetry_name = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--bot") == 0) {
+            options.bot_path = option_value(argc, argv, &i);
+        } else if (strcmp(argv[i], "--watch-level") == 0) {
+            options.watch_level = 1;
+        } else if (strcmp(argv[i], "--rewind") == 0) {
+            options.rewind_seconds = strtod(option_value(argc, argv, &i), NULL);
+        } else if (strcmp(argv[i], "--render-cache") == 0) {
+            options.render_cache = option_value(argc, argv, &i);
+            if (strcmp(options.render_cache, "off") == 0) {
+                options.render_cache = NULL;
+            }
+        } else if (strcmp(argv[i], "--pack") == 0) {
+            options.asset_pack = option_value(argc, argv, &i);
+            options.asset_pack_required = 1;
+            if (strcmp(options.asset_pack, "off") == 0) {
+                options.asset_pack = NULL;
+            }
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            exit(EXIT_SUCCESS);
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if ((options.net_host_port || options.net_join_address) && (options.record_path || options.replay_path)) {
+        fprintf(stderr, "Versus matches can't be recorded or replayed\n");
+        exit(EXIT_FAILURE);
+    }
+    if (options.bot_path && (options.replay_path || options.net_host_port || options.net_join_address)) {
+        fprintf(stderr, "A bot can't play replays or versus matches\n");
+        exit(EXIT_FAILURE);
+    }
+    if (options.rewind_seconds > 0 && (options.net_host_port || options.net_join_address)) {
+        fprintf(stderr, "Versus matches can't be rewound\n");
+        exit(EXIT_FAILURE);
+    }
+    // Holding up after a death means something else with --rewind, a replay only has the buttons
+    if (options.rewind_seconds > 0 && (options.record_path || options.replay_path)) {
+        fprintf(stderr, "Recordings and replays can't be rewound\n");
+        exit(EXIT_FAILURE);
+    }
+    if (options.watch_level && (options.record_path || options.replay_path || options.net_host_port || options.net_join_address)) {
+        fprintf(stderr, "Reloading the level would break recordings, replays and versus matches\n");
+        exit(EXIT_FAILURE);
+    }
+}
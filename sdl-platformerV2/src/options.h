@@ -0,0 +1,39 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "frame_control.h"
+
+// Command line options, parsed once in main()
+typedef struct
+{
+    unsigned int seed;              // Master seed of all random streams
+    const char* record_path;        // Record input to this replay file
+    const char* replay_path;        // Play input back from this replay file
+    int profile;                    // Show the profiler overlay from the start
+    const char* profile_csv_path;   // Write the profiler statistics to this file on exit
+    const char* haptics;            // Vibration motor pin, see haptics_initialize()
+    int mute;                       // Don't open the audio device
+    const char* input;              // Input backend, see input_initialize()
+    PacingMode pacing;              // How frame_control waits for the next frame
+    int low_latency;                // Poll input after the wait and present right after the simulation
+    int latency;                    // Print the input-to-present latency on exit
+    double pacing_stats_interval;   // Print frame pacing statistics every N seconds, 0 to disable
+    int net_host_port;              // Host a versus match on this UDP port, 0 for none
+    const char* net_join_address;   // Join a versus match at HOST:PORT
+    int net_delay;                  // Ticks between reading and simulating the local input in versus matches
+    int net_loss;                   // Percent of the outgoing packets to drop, for testing
+    const char* spectate_address;   // Stream the game to a viewer, see spectator_start()
+    const char* telemetry_name;     // Shared memory segment of the live telemetry, see telemetry_start()
+    const char* bot_path;           // UNIX socket of the bot control, see bot.h
+    int watch_level;                // Reload the edited rooms when the level file changes, see level_watch.h
+    double rewind_seconds;          // Length of the rewind history, 0 to disable, see rewind.h
+    const char* render_cache;       // Render cache file, NULL to disable, see texture_cache.h
+    const char* asset_pack;         // Asset pack to map, NULL for the loose files, see asset_pack.h
+    int asset_pack_required;        // The pack was named on the command line, not just the default one
+} GameOptions;
+
+extern GameOptions options;
+
+void options_parse(int argc, char* argv[]);
+
+#endif /* OPTIONS_H */
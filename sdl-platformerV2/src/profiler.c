@@ -0,0 +1,160 @@
+#include "profiler.h"
+#include "frame_control.h"
+#include "render.h"
+#include "game.h"
+#include <stdio.h>
+#include <time.h>
+
+enum {
+    PROFILER_WINDOW = 128,      // Frames shown in the overlay
+    HISTOGRAM_BINS = 500,       // 0.1 ms bins up to 50 ms, the last one collects the rest
+};
+static const double HISTOGRAM_BIN_MS = 0.1;
+
+static const char* PHASE_NAMES[PHASE_COUNT] = {
+    "draw", "message", "present", "input", "player", "objects", "clean", "wait"
+};
+
+static struct {
+    long long begin[PHASE_COUNT];       // Nanoseconds
+    long long current[PHASE_COUNT];     // Time of the current frame, nanoseconds
+    float window[PHASE_COUNT][PROFILER_WINDOW]; // Milliseconds
+    unsigned int histogram[PHASE_COUNT][HISTOGRAM_BINS];
+    double total[PHASE_COUNT];          // Milliseconds
+    double max[PHASE_COUNT];            // Milliseconds
+    unsigned long frame_count;
+    int overlay_visible;
+} profiler = {0};
+
+static inline long long get_time_ns() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+void profiler_begin(ProfilerPhase phase) {
+    profiler.begin[phase] = get_time_ns();
+}
+
+void profiler_end(ProfilerPhase phase) {
+    profiler.current[phase] += get_time_ns() - profiler.begin[phase];
+}
+
+void profiler_end_frame(void) {
+    const int slot = profiler.frame_count % PROFILER_WINDOW;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        const double ms = profiler.current[p] / 1e6;
+        int bin = ms / HISTOGRAM_BIN_MS;
+        if (bin >= HISTOGRAM_BINS) {
+            bin = HISTOGRAM_BINS - 1;
+        }
+        profiler.window[p][slot] = ms;
+        profiler.histogram[p][bin]++;
+        profiler.total[p] += ms;
+        if (ms > profiler.max[p]) {
+            profiler.max[p] = ms;
+        }
+        profiler.current[p] = 0;
+    }
+    profiler.frame_count++;
+}
+
+static int window_size() {
+    return profiler.frame_count < PROFILER_WINDOW ? profiler.frame_count : PROFILER_WINDOW;
+}
+
+double profiler_get_mean(ProfilerPhase phase) {
+    const int n = window_size();
+    double sum = 0;
+    for (int i = 0; i < n; ++i) {
+        sum += profiler.window[phase][i];
+    }
+    return n ? sum / n : 0;
+}
+
+double profiler_get_max(ProfilerPhase phase) {
+    const int n = window_size();
+    double max = 0;
+    for (int i = 0; i < n; ++i) {
+        if (profiler.window[phase][i] > max) {
+            max = profiler.window[phase][i];
+        }
+    }
+    return max;
+}
+
+const char* profiler_get_name(ProfilerPhase phase) {
+    return PHASE_NAMES[phase];
+}
+
+void profiler_toggle_overlay(void) {
+    profiler.overlay_visible = !profiler.overlay_visible;
+}
+
+int profiler_is_overlay_visible(void) {
+    return profiler.overlay_visible;
+}
+
+void profiler_draw_overlay(void) {
+    char line[64];
+    int y = 0;
+    const int lineHeight = OVERLAY_FONT_SIZE + 2;
+
+    drawOverlayBox(0, 0, 32 * OVERLAY_FONT_SIZE, (PHASE_COUNT + 5) * lineHeight + 4);
+
+    const double budget = FRAME_RATE > 0 ? 1000.0 / FRAME_RATE : 0;
+    double work = 0, work_max = 0;
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        if (p != PHASE_WAIT) {
+            work += profiler_get_mean(p);
+            work_max += profiler_get_max(p);
+        }
+    }
+
+    snprintf(line, sizeof(line), "fps %5.1f  budget %4.1f ms", frame_control_get_current_fps(), budget);
+    drawText(line, 4, y += 2);
+    snprintf(line, sizeof(line), "work    %6.2f  max %6.2f", work, work_max);
+    drawText(line, 4, y += lineHeight);
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        snprintf(line, sizeof(line), "%-7s %6.2f  max %6.2f", PHASE_NAMES[p], profiler_get_mean(p), profiler_get_max(p));
+        drawText(line, 4, y += lineHeight);
+    }
+
+    int active = 0;
+    for (int i = 0; i < level->objects.count; ++i) {
+        active += !level->objects.array[i]->removed;
+    }
+    snprintf(line, sizeof(line), "objects %d (active %d)", level->objects.count, active);
+    drawText(line, 4, y += lineHeight);
+    snprintf(line, sizeof(line), "draw calls %d", getDrawCallCount());
+    drawText(line, 4, y += lineHeight);
+}
+
+// Value below which the given share of the samples lie, from the histogram
+static double histogram_percentile(ProfilerPhase phase, double share) {
+    const unsigned long target = profiler.frame_count * share;
+    unsigned long count = 0;
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin) {
+        count += profiler.histogram[phase][bin];
+        if (count > target) {
+            return (bin + 1) * HISTOGRAM_BIN_MS;
+        }
+    }
+    return HISTOGRAM_BINS * HISTOGRAM_BIN_MS;
+}
+
+void profiler_write_csv(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Unable to create file %s\n", path);
+        return;
+    }
+    fprintf(file, "phase,frames,mean_ms,p50_ms,p99_ms,max_ms\n");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        fprintf(file, "%s,%lu,%.4f,%.1f,%.1f,%.4f\n", PHASE_NAMES[p], profiler.frame_count,
+                profiler.frame_count ? profiler.total[p] / profiler.frame_count : 0,
+                histogram_percentile(p, 0.5), histogram_percentile(p, 0.99), profiler.max[p]);
+    }
+    fclose(file);
+    printf("Profile written to %s\n", path);
+}
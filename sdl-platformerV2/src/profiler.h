@@ -0,0 +1,37 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Phases of a frame, in the order processFrame() runs them
+typedef enum
+{
+    PHASE_DRAW = 0,
+    PHASE_MESSAGE,
+    PHASE_PRESENT,
+    PHASE_INPUT,
+    PHASE_PLAYER,
+    PHASE_OBJECTS,
+    PHASE_CLEAN,
+    PHASE_WAIT,
+    PHASE_COUNT
+} ProfilerPhase;
+
+// Times the following statement or block as the given phase:
+//     PROFILE(PHASE_DRAW) { drawScreen(); }
+// Leaving the block with return or break skips the measurement.
+#define PROFILE(phase) \
+    for (int profile_once_ = (profiler_begin(phase), 1); profile_once_; profile_once_ = (profiler_end(phase), 0))
+
+void profiler_begin(ProfilerPhase phase);
+void profiler_end(ProfilerPhase phase);
+void profiler_end_frame(void); // Commits the phase times of the current frame
+
+double profiler_get_mean(ProfilerPhase phase); // Milliseconds, over the last frames
+double profiler_get_max(ProfilerPhase phase);  // Milliseconds, over the last frames
+const char* profiler_get_name(ProfilerPhase phase);
+
+void profiler_toggle_overlay(void);
+int profiler_is_overlay_visible(void);
+void profiler_draw_overlay(void);
+void profiler_write_csv(const char* path); // Whole-run statistics per phase
+
+#endif /* PROFILER_H */
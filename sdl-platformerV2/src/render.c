@@ -2,15 +2,22 @@
 #include "game.h"
 #include "frame_control.h"
 #include "helpers.h"
+#include "texture_cache.h"
+#include "asset_pack.h"
 #include "SDL2/SDL_ttf.h"
+#include <limits.h>
 #include <string.h>
 #include <stdio.h>
 
 SDL_Renderer* renderer;
 static SDL_Texture* sprites;
 static SDL_Window* window;
-static TTF_Font* font;
 static SDL_Texture* messages[MESSAGE_COUNT];
+static SDL_Texture* glyphs;     // Printable ASCII characters of the monospace font in one row
+static int glyphWidth;
+static int glyphHeight;
+static int drawCalls;
+static int renderCacheUsed;
 
 static const SDL_Color TEXT_COLOR = {255, 255, 255, 255};
 static const SDL_Color TEXT_BOX_CONTENT_COLOR = {0, 0, 0, 255};
@@ -18,38 +25,195 @@ static const SDL_Color TEXT_BOX_BORDER_COLOR = {255, 255, 255, 255};
 static const int TEXT_BOX_BORDER = 1 * SIZE_FACTOR;
 static const int TEXT_BOX_PADDING = 5 * SIZE_FACTOR;
 static const int TEXT_FONT_SIZE = 8 * SIZE_FACTOR;
+static const char FIRST_GLYPH = ' ';
+static const char LAST_GLYPH = '~';
+static const Uint8 SPRITE_COLOR_KEY[3] = {90, 82, 104}; // Transparent in the sprite sheet
 
 
-// The text must be one-line
-static void initializeMessage( MessageId id, const char* text )
+// The images initializeRender() makes textures of, in the order of the render cache
+enum
 {
-    SDL_Surface* surface = TTF_RenderText_Solid(font, text, TEXT_COLOR);
-    messages[id] = SDL_CreateTextureFromSurface(renderer, surface);
+    IMAGE_SPRITES = 0,
+    IMAGE_MESSAGES,                             // One per MessageId
+    IMAGE_GLYPHS = IMAGE_MESSAGES + MESSAGE_COUNT,
+    IMAGE_COUNT
+};
+
+static const char* const MESSAGE_TEXTS[MESSAGE_COUNT] = {
+    [MESSAGE_PLAYER_KILLED] = "You lost a life",
+    [MESSAGE_GAME_OVER] = "Game over",
+    [MESSAGE_LEVEL_COMPLETE] = "Level complete!",
+};
+
+// Converts the surface to the texture format, a colour key becomes alpha
+static SDL_Surface* convertSurface( SDL_Surface* surface, Uint32 format )
+{
+    ensure_condition(surface != NULL, "convertSurface(): No surface");
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, format, 0);
+    ensure_condition(converted != NULL, "convertSurface(): Can't convert surface");
     SDL_FreeSurface(surface);
+    return converted;
 }
 
-void initializeRender( const char* spritesPath, const char* fontPath )
+// Decodes the sprite sheet and rasterizes the texts, what a warm start finds in the render cache.
+// The texts must be one-line.
+static void buildImages( const char* spritesPath, const char* fontPath, Uint32 format, SDL_Surface* surfaces[IMAGE_COUNT] )
 {
-    // Window and renderer
-    SDL_CreateWindowAndRenderer(LEVEL_WIDTH * SIZE_FACTOR, LEVEL_HEIGHT * SIZE_FACTOR, 0, &window, &renderer);
-
     // Sprites
-    static const Uint8 transparent[3] = {90, 82, 104};
-    SDL_Surface* surface = SDL_LoadBMP(spritesPath);
-    ensure_condition(surface != NULL,  "initializeRender(): Can't load sprite sheet");
-    SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, transparent[0], transparent[1], transparent[2]));
-    sprites = SDL_CreateTextureFromSurface(renderer, surface);
-    SDL_FreeSurface(surface);
+    SDL_Surface* surface = SDL_LoadBMP_RW(asset_open(spritesPath), 1);
+    ensure_condition(surface != NULL,  "buildImages(): Can't load sprite sheet");
+    SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, SPRITE_COLOR_KEY[0], SPRITE_COLOR_KEY[1], SPRITE_COLOR_KEY[2]));
+    surfaces[IMAGE_SPRITES] = convertSurface(surface, format);
 
-    // Font
+    // Messages
     TTF_Init();
-    font = TTF_OpenFont(fontPath, TEXT_FONT_SIZE);
-    ensure_condition(font != NULL, "initRender(): Can't open font");
+    TTF_Font* font = TTF_OpenFontRW(asset_open(fontPath), 1, TEXT_FONT_SIZE);
+    ensure_condition(font != NULL, "buildImages(): Can't open font");
+    for (int id = 0; id < MESSAGE_COUNT; ++id)
+    {
+        surfaces[IMAGE_MESSAGES + id] = convertSurface(TTF_RenderText_Solid(font, MESSAGE_TEXTS[id], TEXT_COLOR), format);
+    }
+    TTF_CloseFont(font);
 
-    // Messages
-    initializeMessage(MESSAGE_PLAYER_KILLED,  "You lost a life");
-    initializeMessage(MESSAGE_GAME_OVER,      "Game over");
-    initializeMessage(MESSAGE_LEVEL_COMPLETE, "Level complete!");
+    // All printable characters once, so drawText() never has to rasterize
+    TTF_Font* overlayFont = TTF_OpenFontRW(asset_open(fontPath), 1, OVERLAY_FONT_SIZE);
+    ensure_condition(overlayFont != NULL, "buildImages(): Can't open font");
+    char text[LAST_GLYPH - FIRST_GLYPH + 2];
+    for (char ch = FIRST_GLYPH; ch <= LAST_GLYPH; ++ch) {
+        text[ch - FIRST_GLYPH] = ch;
+    }
+    text[sizeof(text) - 1] = '\0';
+    surfaces[IMAGE_GLYPHS] = convertSurface(TTF_RenderText_Solid(overlayFont, text, TEXT_COLOR), format);
+    TTF_CloseFont(overlayFont);
+}
+
+// Hash of everything buildImages() takes from the code, part of the render cache key
+static Uint32 hashImageSettings()
+{
+    const int sizes[] = {TEXT_FONT_SIZE, OVERLAY_FONT_SIZE, FIRST_GLYPH, LAST_GLYPH};
+    Uint32 hash = hash_bytes(sizes, sizeof(sizes), HASH_INITIAL);
+    hash = hash_bytes(SPRITE_COLOR_KEY, sizeof(SPRITE_COLOR_KEY), hash);
+    hash = hash_bytes(&TEXT_COLOR, sizeof(TEXT_COLOR), hash);
+    for (int id = 0; id < MESSAGE_COUNT; ++id)
+    {
+        hash = hash_bytes(MESSAGE_TEXTS[id], strlen(MESSAGE_TEXTS[id]) + 1, hash);
+    }
+    return hash;
+}
+
+// The file the asset is read from, the pack if it has the asset
+static void getAssetSource( const char* name, char* path, size_t size )
+{
+    size_t assetSize;
+    if (asset_pack_find(name, &assetSize))
+    {
+        snprintf(path, size, "%s", asset_pack_get_path());
+    }
+    else
+    {
+        asset_resolve(name, path, size);
+    }
+}
+
+static SDL_Texture* createTexture( const CachedImage* image, Uint32 format )
+{
+    SDL_Texture* texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, image->width, image->height);
+    ensure_condition(texture != NULL, "createTexture(): Can't create texture");
+    SDL_UpdateTexture(texture, NULL, image->pixels, image->pitch);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    return texture;
+}
+
+// The first format of the renderer with alpha, so the textures are uploaded without conversion
+static Uint32 getTextureFormat()
+{
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0)
+    {
+        for (Uint32 i = 0; i < info.num_texture_formats; ++i)
+        {
+            if (SDL_ISPIXELFORMAT_ALPHA(info.texture_formats[i]))
+            {
+                return info.texture_formats[i];
+            }
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+void initializeRender( const char* spritesPath, const char* fontPath, const char* cachePath, int vsync )
+{
+    // Window and renderer
+    window = SDL_CreateWindow("", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                              LEVEL_WIDTH * SIZE_FACTOR, LEVEL_HEIGHT * SIZE_FACTOR, 0);
+    ensure_condition(window != NULL, "initializeRender(): Can't create window");
+    renderer = vsync ? SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC) : NULL;
+    if (renderer == NULL)
+    {
+        renderer = SDL_CreateRenderer(window, -1, 0);
+    }
+    ensure_condition(renderer != NULL, "initializeRender(): Can't create renderer");
+
+    // Images, from the render cache if it was made from the same files
+    const Uint32 format = getTextureFormat();
+    char spritesSource[PATH_MAX], fontSource[PATH_MAX];
+    getAssetSource(spritesPath, spritesSource, sizeof(spritesSource));
+    getAssetSource(fontPath, fontSource, sizeof(fontSource));
+    const char* const sources[] = {spritesSource, fontSource};
+    const Uint32 key = texture_cache_key(sources, 2, hashImageSettings());
+    CachedImage images[IMAGE_COUNT];
+    SDL_Surface* surfaces[IMAGE_COUNT] = {NULL};
+    renderCacheUsed = cachePath && texture_cache_load(cachePath, key, format, images, IMAGE_COUNT);
+    if (!renderCacheUsed)
+    {
+        buildImages(spritesPath, fontPath, format, surfaces);
+        for (int i = 0; i < IMAGE_COUNT; ++i)
+        {
+            images[i] = (CachedImage){surfaces[i]->w, surfaces[i]->h, surfaces[i]->pitch, 0, surfaces[i]->pixels};
+        }
+        images[IMAGE_GLYPHS].data = surfaces[IMAGE_GLYPHS]->w / (LAST_GLYPH - FIRST_GLYPH + 1);
+        if (cachePath)
+        {
+            texture_cache_save(cachePath, key, format, images, IMAGE_COUNT);
+        }
+    }
+
+    sprites = createTexture(&images[IMAGE_SPRITES], format);
+    for (int id = 0; id < MESSAGE_COUNT; ++id)
+    {
+        messages[id] = createTexture(&images[IMAGE_MESSAGES + id], format);
+    }
+    glyphs = createTexture(&images[IMAGE_GLYPHS], format);
+    glyphWidth = images[IMAGE_GLYPHS].data;
+    glyphHeight = images[IMAGE_GLYPHS].height;
+
+    texture_cache_close();
+    for (int i = 0; i < IMAGE_COUNT; ++i)
+    {
+        SDL_FreeSurface(surfaces[i]);
+    }
+}
+
+int wasRenderCacheUsed()
+{
+    return renderCacheUsed;
+}
+
+int isVsyncEnabled()
+{
+    SDL_RendererInfo info;
+    return SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC);
+}
+
+int getDisplayRefreshRate()
+{
+    SDL_DisplayMode mode;
+    const int display = SDL_GetWindowDisplayIndex(window);
+    if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0)
+    {
+        return 0;
+    }
+    return mode.refresh_rate;
 }
 
 void drawSprite( SDL_Rect spriteRect, int x, int y, int frame, SDL_RendererFlip flip )
@@ -57,6 +221,7 @@ void drawSprite( SDL_Rect spriteRect, int x, int y, int frame, SDL_RendererFlip
     spriteRect.x += spriteRect.w * frame;
     SDL_Rect dstRect = {x * SIZE_FACTOR, y * SIZE_FACTOR, spriteRect.w * SIZE_FACTOR, spriteRect.h * SIZE_FACTOR};
     SDL_RenderCopyEx(renderer, sprites, &spriteRect, &dstRect, 0, NULL, flip);
+    drawCalls += 1;
 }
 
 static void drawObjectBody( Object* object )
@@ -98,6 +263,13 @@ void drawObject( Object* object )
     SDL_SetTextureAlphaMod(sprites, 255);
 }
 
+void drawObjectTinted( Object* object, SDL_Color color )
+{
+    SDL_SetTextureColorMod(sprites, color.r, color.g, color.b);
+    drawObject(object);
+    SDL_SetTextureColorMod(sprites, 255, 255, 255);
+}
+
 static void drawBox( SDL_Rect box, int border, SDL_Color borderColor, SDL_Color contentColor )
 {
     const SDL_Rect borderRect = {box.x - border, box.y - border, box.w + border * 2, box.h + border * 2};
@@ -106,6 +278,7 @@ static void drawBox( SDL_Rect box, int border, SDL_Color borderColor, SDL_Color
 
     SDL_SetRenderDrawColor(renderer, contentColor.r, contentColor.g, contentColor.b, contentColor.a);
     SDL_RenderFillRect(renderer, &box);
+    drawCalls += 2;
 }
 
 void drawMessage( MessageId id )
@@ -123,11 +296,58 @@ void drawMessage( MessageId id )
     drawBox(boxRect, TEXT_BOX_BORDER, TEXT_BOX_BORDER_COLOR, TEXT_BOX_CONTENT_COLOR);
     
     SDL_RenderCopy(renderer, texture, NULL, &textRect);
+    drawCalls += 1;
+}
+
+// Draws one line of text in screen pixels with the overlay font
+void drawText( const char* text, int x, int y )
+{
+    SDL_Rect src = {0, 0, glyphWidth, glyphHeight};
+    SDL_Rect dst = {x, y, glyphWidth, glyphHeight};
+    for (; *text; ++text, dst.x += glyphWidth) {
+        if (*text > FIRST_GLYPH && *text <= LAST_GLYPH) {
+            src.x = (*text - FIRST_GLYPH) * glyphWidth;
+            SDL_RenderCopy(renderer, glyphs, &src, &dst);
+            drawCalls += 1;
+        }
+    }
+}
+
+// Darkens a rectangle of the screen, in screen pixels
+void drawOverlayBox( int x, int y, int w, int h )
+{
+    const SDL_Rect box = {x, y, w, h};
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(renderer, &box);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    drawCalls += 1;
+}
+
+int getDrawCallCount()
+{
+    return drawCalls;
+}
+
+void resetDrawCallCount()
+{
+    drawCalls = 0;
 }
 
 void drawScreen()
 {
-    // Level
+    for (int i = 0; i < level->objects.count; ++ i) {
+        Object* object = level->objects.array[i];
+        if (!object->removed) {
+            animateObject(object);
+        }
+    }
+    drawLevel(level);
+}
+
+void drawLevel( Level* level )
+{
+    // Cells
     for (int r = 0; r < ROW_COUNT; ++ r) {
         for (int c = 0; c < COLUMN_COUNT; ++ c) {
             ObjectType* type = level->cells[r][c];
@@ -136,25 +356,27 @@ void drawScreen()
     }
 
     // Objects
-    const double dt = frame_control_get_elapsed_frame_time() / 1000.0;
     for (int i = 0; i < level->objects.count; ++ i) {
         Object* object = level->objects.array[i];
-        Animation* anim = &object->anim;
-        if (object->removed) {
-            continue;
+        if (!object->removed) {
+            drawObject(object);
         }
-        anim->frameDelayCounter -= dt;
-        if (anim->frameDelayCounter <= 0) {
-            anim->frameDelayCounter = anim->frameDelay;
-            anim->frame += 1;
-            if (anim->frame > anim->frameEnd) {
-                anim->frame = anim->frameStart;
-            }
-            if (anim->type == ANIMATION_FLIP) {
-                anim->flip = anim->flip == SDL_FLIP_NONE ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
-            }
+    }
+}
+
+void animateObject( Object* object )
+{
+    Animation* anim = &object->anim;
+    anim->frameDelayCounter -= frame_control_get_elapsed_frame_time() / 1000.0;
+    if (anim->frameDelayCounter <= 0) {
+        anim->frameDelayCounter = anim->frameDelay;
+        anim->frame += 1;
+        if (anim->frame > anim->frameEnd) {
+            anim->frame = anim->frameStart;
+        }
+        if (anim->type == ANIMATION_FLIP) {
+            anim->flip = anim->flip == SDL_FLIP_NONE ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
         }
-        drawObject(object);
     }
 }
 
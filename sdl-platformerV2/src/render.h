@@ -3,13 +3,26 @@
 
 #include "types.h"
 
+enum { OVERLAY_FONT_SIZE = 8 }; // Pixels, overlay text is drawn unscaled
+
 extern SDL_Renderer* renderer;
 
-void initializeRender( const char* spritesPath, const char* fontPath );
+// cachePath is the render cache (see texture_cache.h), NULL to always build the textures
+void initializeRender( const char* spritesPath, const char* fontPath, const char* cachePath, int vsync );
+int wasRenderCacheUsed(); // Whether the textures came from the render cache
+int isVsyncEnabled();
+int getDisplayRefreshRate(); // Hz as reported by SDL, 0 if unknown
 void drawSprite( SDL_Rect spriteRect, int x, int y, int frame, SDL_RendererFlip flip );
 void drawObject( Object* object );
+void drawObjectTinted( Object* object, SDL_Color color );
+void animateObject( Object* object ); // Advances the animation by the frame time
 void drawMessage( MessageId message );
-void drawScreen();
+void drawScreen();                  // Advances the animations of the current level, then draws it
+void drawLevel( Level* level );     // Draws the cells and objects as they are
+void drawText( const char* text, int x, int y );
+void drawOverlayBox( int x, int y, int w, int h );
+int getDrawCallCount();
+void resetDrawCallCount();
 void setAnimation( Object* object, int frameStart, int frameEnd, int fps );
 void setAnimationWave( Object* object, int fps );
 void setAnimationFlip( Object* object, int frame, int fps );
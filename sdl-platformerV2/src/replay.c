@@ -0,0 +1,104 @@
+#include "replay.h"
+#include "helpers.h"
+#include <stdio.h>
+#include <string.h>
+
+// File layout, native byte order:
+//   header: "PLRP", Uint16 version, Uint16 frame rate, Uint32 seed
+//   frame:  Uint8 input, double frame time (ms), Uint32 checksum
+static const char REPLAY_MAGIC[4] = {'P', 'L', 'R', 'P'};
+static const Uint16 REPLAY_VERSION = 1;
+
+typedef enum {
+    REPLAY_OFF = 0,
+    REPLAY_RECORDING,
+    REPLAY_PLAYING
+} ReplayMode;
+
+static struct {
+    ReplayMode mode;
+    FILE* file;
+    unsigned long frame;
+    Uint32 expected_checksum;
+} replay = {0};
+
+void replay_start_recording(const char* path, Uint32 seed) {
+    replay.file = fopen(path, "wb");
+    ensure_condition(replay.file != NULL, "replay_start_recording(): Can't create replay file");
+
+    const Uint16 frame_rate = FRAME_RATE;
+    fwrite(REPLAY_MAGIC, sizeof(REPLAY_MAGIC), 1, replay.file);
+    fwrite(&REPLAY_VERSION, sizeof(REPLAY_VERSION), 1, replay.file);
+    fwrite(&frame_rate, sizeof(frame_rate), 1, replay.file);
+    fwrite(&seed, sizeof(seed), 1, replay.file);
+
+    replay.mode = REPLAY_RECORDING;
+    replay.frame = 0;
+    printf("Recording replay to %s\n", path);
+}
+
+void replay_start_playback(const char* path, Uint32* seed) {
+    replay.file = fopen(path, "rb");
+    ensure_condition(replay.file != NULL, "replay_start_playback(): Can't open replay file");
+
+    char magic[sizeof(REPLAY_MAGIC)];
+    Uint16 version, frame_rate;
+    const int valid = fread(magic, sizeof(magic), 1, replay.file) == 1 &&
+                      memcmp(magic, REPLAY_MAGIC, sizeof(magic)) == 0 &&
+                      fread(&version, sizeof(version), 1, replay.file) == 1 &&
+                      version == REPLAY_VERSION &&
+                      fread(&frame_rate, sizeof(frame_rate), 1, replay.file) == 1 &&
+                      fread(seed, sizeof(*seed), 1, replay.file) == 1;
+    ensure_condition(valid, "replay_start_playback(): Not a replay file or unsupported version");
+    if (frame_rate != FRAME_RATE) {
+        printf("Replay was recorded at %d fps, playing at %d fps\n", frame_rate, FRAME_RATE);
+    }
+
+    replay.mode = REPLAY_PLAYING;
+    replay.frame = 0;
+    printf("Playing replay %s\n", path);
+}
+
+void replay_stop(void) {
+    if (replay.mode == REPLAY_OFF) {
+        return;
+    }
+    fclose(replay.file);
+    replay.file = NULL;
+    replay.mode = REPLAY_OFF;
+}
+
+int replay_is_recording(void) {
+    return replay.mode == REPLAY_RECORDING;
+}
+
+int replay_is_playing(void) {
+    return replay.mode == REPLAY_PLAYING;
+}
+
+void replay_record_frame(Uint8 input, double frame_time, Uint32 checksum) {
+    fwrite(&input, sizeof(input), 1, replay.file);
+    fwrite(&frame_time, sizeof(frame_time), 1, replay.file);
+    fwrite(&checksum, sizeof(checksum), 1, replay.file);
+    replay.frame++;
+}
+
+int replay_next_frame(Uint8* input, double* frame_time) {
+    if (fread(input, sizeof(*input), 1, replay.file) != 1 ||
+        fread(frame_time, sizeof(*frame_time), 1, replay.file) != 1 ||
+        fread(&replay.expected_checksum, sizeof(replay.expected_checksum), 1, replay.file) != 1) {
+        printf("Replay finished, %lu frames matched\n", replay.frame);
+        return 0;
+    }
+    return 1;
+}
+
+int replay_verify_frame(Uint32 checksum) {
+    if (checksum != replay.expected_checksum) {
+        fprintf(stderr, "Replay diverged at frame %lu: checksum %08x, recorded %08x\n",
+                replay.frame, (unsigned)checksum, (unsigned)replay.expected_checksum);
+        return 0;
+    }
+    replay.frame++;
+    return 1;
+}
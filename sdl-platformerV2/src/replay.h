@@ -0,0 +1,21 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL2/SDL.h>
+
+// Replay files store the master seed followed by one record per frame:
+// the INPUT_* flags, the frame time the logic used and a checksum of the
+// state after the frame. Playback compares the checksums, so a divergence
+// is reported at the first frame that differs.
+
+void replay_start_recording(const char* path, Uint32 seed);
+void replay_start_playback(const char* path, Uint32* seed); // Returns the recorded seed
+void replay_stop(void);
+int replay_is_recording(void);
+int replay_is_playing(void);
+
+void replay_record_frame(Uint8 input, double frame_time, Uint32 checksum);
+int replay_next_frame(Uint8* input, double* frame_time); // Returns 0 at the end of the replay
+int replay_verify_frame(Uint32 checksum);                 // Returns 0 if the state diverged
+
+#endif /* REPLAY_H */
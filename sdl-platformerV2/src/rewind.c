@@ -0,0 +1,270 @@
+#include "rewind.h"
+#include "game.h"
+#include "helpers.h"
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Encoded record: pairs of Uint16 count of unchanged bytes, Uint16 count of
+// changed bytes, then the changed bytes XOR the keyframe. Keyframes are
+// encoded the same way against zeros. A run of changed bytes only ends at
+// MIN_ZERO_RUN unchanged ones, so the encoding is at most twice the state.
+enum {
+    MIN_ZERO_RUN = 4,
+    MAX_RUN = 0xffff
+};
+
+typedef struct {
+    size_t offset;      // In the buffer
+    size_t size;        // Encoded
+    size_t stateSize;   // Decoded
+    int keyframe;
+} RewindRecord;
+
+static struct {
+    Uint8* buffer;              // REWIND_BUDGET bytes, used as a ring
+    size_t head;                // Where the next record goes
+    RewindRecord* records;      // Ring of the records, oldest first
+    int capacity;
+    int first;
+    int count;
+    Snapshot state;             // State of the current tick, also used to restore
+    Snapshot key;               // State of the newest keyframe
+    int sinceKey;               // Ticks since the newest keyframe
+    Uint8* encoded;
+    size_t encodedReserved;
+    double recordTime;          // Microseconds, sum over all records
+    double recordTimeMax;
+    double restoreTimeMax;
+    unsigned long recorded;
+} history;
+
+static double get_time_us(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec / 1e3;
+}
+
+static inline Uint8 changed_byte(const Uint8* data, const Uint8* key, size_t i) {
+    return key ? data[i] ^ key[i] : data[i];
+}
+
+// Number of unchanged bytes from i on, up to limit, eight at a time while possible
+static size_t count_unchanged(const Uint8* data, const Uint8* key, size_t i, size_t limit) {
+    size_t n = 0;
+    Uint64 a, b = 0;
+    while (n + 8 <= limit) {
+        memcpy(&a, data + i + n, 8);
+        if (key) {
+            memcpy(&b, key + i + n, 8);
+        }
+        if (a != b) {
+            break;
+        }
+        n += 8;
+    }
+    while (n < limit && changed_byte(data, key, i + n) == 0) {
+        ++n;
+    }
+    return n;
+}
+
+static size_t encode(const Uint8* data, const Uint8* key, size_t size, Uint8* out) {
+    Uint8* p = out;
+    size_t i = 0;
+    while (i < size) {
+        const size_t rest = size - i;
+        const Uint16 zeros = count_unchanged(data, key, i, rest < MAX_RUN ? rest : MAX_RUN);
+        i += zeros;
+
+        const size_t start = i;
+        int run = 0;
+        while (i < size && i - start < MAX_RUN) {
+            run = changed_byte(data, key, i) ? 0 : run + 1;
+            ++i;
+            if (run == MIN_ZERO_RUN) {
+                i -= run;
+                break;
+            }
+        }
+        const Uint16 literals = i - start;
+        memcpy(p, &zeros, 2);
+        memcpy(p + 2, &literals, 2);
+        p += 4;
+        for (size_t j = start; j < i; ++j) {
+            *p++ = changed_byte(data, key, j);
+        }
+    }
+    return p - out;
+}
+
+// XORs the changes onto the state, which holds the keyframe or zeros
+static void decode(const Uint8* in, size_t size, Uint8* state) {
+    const Uint8* end = in + size;
+    size_t i = 0;
+    while (in < end) {
+        Uint16 zeros, literals;
+        memcpy(&zeros, in, 2);
+        memcpy(&literals, in + 2, 2);
+        in += 4;
+        i += zeros;
+        for (Uint16 j = 0; j < literals; ++j) {
+            state[i++] ^= *in++;
+        }
+    }
+}
+
+static RewindRecord* get_record(int i) {
+    return &history.records[(history.first + i) % history.capacity];
+}
+
+// Deltas without their keyframe are useless, so they go with it
+static void drop_oldest(void) {
+    do {
+        history.first = (history.first + 1) % history.capacity;
+        history.count -= 1;
+    } while (history.count > 0 && !get_record(0)->keyframe);
+}
+
+// Makes room for size bytes at the head, returns 0 if the record can't be stored
+static int reserve(size_t size, int keyframe) {
+    if (size > REWIND_BUDGET) {
+        return 0;
+    }
+    if (history.head + size > REWIND_BUDGET) {
+        // The records behind the head are older than all in front of it
+        while (history.count > 0 && get_record(0)->offset >= history.head) {
+            drop_oldest();
+        }
+        history.head = 0;
+    }
+    while (history.count > 0) {
+        const RewindRecord* oldest = get_record(0);
+        if (history.count < history.capacity &&
+            (oldest->offset >= history.head + size || oldest->offset + oldest->size <= history.head)) {
+            break;
+        }
+        drop_oldest();
+    }
+    return keyframe || history.count > 0;
+}
+
+void rewind_start(double seconds) {
+    history.capacity = seconds * FRAME_RATE;
+    if (history.capacity < 1) {
+        return;
+    }
+    history.buffer = malloc(REWIND_BUDGET);
+    history.records = malloc(sizeof(RewindRecord) * history.capacity);
+    ensure_condition(history.buffer && history.records, "rewind_start(): Out of memory");
+    snapshot_initialize(&history.state);
+    snapshot_initialize(&history.key);
+    rewind_reset();
+    printf("Rewind: %.1f seconds within %d KB\n", seconds, REWIND_BUDGET / 1024);
+}
+
+void rewind_stop(void) {
+    if (!history.records) {
+        return;
+    }
+    size_t used = 0;
+    for (int i = 0; i < history.count; ++i) {
+        used += get_record(i)->size;
+    }
+    if (history.recorded) {
+        printf("Rewind: %d ticks in %zu KB, recording %.1f us mean %.1f us max, restoring %.1f us max\n",
+               history.count, used / 1024, history.recordTime / history.recorded, history.recordTimeMax,
+               history.restoreTimeMax);
+    }
+    free(history.buffer);
+    free(history.records);
+    free(history.encoded);
+    snapshot_free(&history.state);
+    snapshot_free(&history.key);
+    memset(&history, 0, sizeof(history));
+}
+
+int rewind_is_enabled(void) {
+    return history.records != NULL;
+}
+
+void rewind_reset(void) {
+    history.first = 0;
+    history.count = 0;
+    history.head = 0;
+    history.sinceKey = REWIND_KEY_INTERVAL;
+}
+
+void rewind_record(void) {
+    if (!history.records) {
+        return;
+    }
+    const double start = get_time_us();
+    snapshot_clear(&history.state);
+    saveGame(&history.state);
+    const size_t size = history.state.size;
+    const int keyframe = history.sinceKey >= REWIND_KEY_INTERVAL || size != history.key.size;
+
+    if (history.encodedReserved < size * 2 + 8) {
+        history.encodedReserved = size * 2 + 8;
+        history.encoded = realloc(history.encoded, history.encodedReserved);
+        ensure_condition(history.encoded != NULL, "rewind_record(): Out of memory");
+    }
+    const size_t encodedSize = encode(history.state.data, keyframe ? NULL : history.key.data, size, history.encoded);
+    if (!reserve(encodedSize, keyframe)) {
+        history.sinceKey = REWIND_KEY_INTERVAL;
+        return;
+    }
+    memcpy(history.buffer + history.head, history.encoded, encodedSize);
+    *get_record(history.count) = (RewindRecord){history.head, encodedSize, size, keyframe};
+    history.count += 1;
+    history.head += encodedSize;
+
+    if (keyframe) {
+        snapshot_clear(&history.key);
+        snapshot_write(&history.key, history.state.data, size);
+        history.sinceKey = 0;
+    }
+    history.sinceKey += 1;
+
+    const double time = get_time_us() - start;
+    history.recordTime += time;
+    history.recordTimeMax = time > history.recordTimeMax ? time : history.recordTimeMax;
+    history.recorded += 1;
+}
+
+int rewind_step_back(void) {
+    if (!history.records || history.count == 0) {
+        return 0;
+    }
+    const double start = get_time_us();
+    const int newest = history.count - 1;
+    int key = newest;
+    while (!get_record(key)->keyframe) {
+        key -= 1;
+    }
+
+    const RewindRecord* record = get_record(newest);
+    snapshot_clear(&history.state);
+    while (history.state.size < record->stateSize) {
+        static const Uint8 ZEROS[256] = {0};
+        const size_t rest = record->stateSize - history.state.size;
+        snapshot_write(&history.state, ZEROS, rest < sizeof(ZEROS) ? rest : sizeof(ZEROS));
+    }
+    decode(history.buffer + get_record(key)->offset, get_record(key)->size, history.state.data);
+    if (key != newest) {
+        decode(history.buffer + record->offset, record->size, history.state.data);
+    }
+    loadGame(&history.state);
+
+    // The history continues from here, with a new keyframe
+    history.head = record->offset;
+    history.count -= 1;
+    history.sinceKey = REWIND_KEY_INTERVAL;
+
+    const double time = get_time_us() - start;
+    history.restoreTimeMax = time > history.restoreTimeMax ? time : history.restoreTimeMax;
+    return 1;
+}
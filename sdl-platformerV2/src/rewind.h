@@ -0,0 +1,27 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+
+// Rewind history: after every playing tick the game state (see saveGame())
+// is stored in a ring within a fixed memory budget. Every REWIND_KEY_INTERVAL
+// ticks, and whenever the state changes its size, the record is a keyframe,
+// the others are the XOR with their keyframe, run length encoded. Most of the
+// state doesn't change within a fraction of a second, so a delta is mostly one
+// run of zeros. The oldest records are dropped for new ones, a rewind restores
+// the newest record and drops it.
+
+enum {
+    REWIND_KEY_INTERVAL = 24,                // Ticks, half a second
+    REWIND_BUDGET = 4 * 1024 * 1024          // Bytes of encoded records
+};
+
+void rewind_start(double seconds);
+void rewind_stop(void);
+int rewind_is_enabled(void);
+
+void rewind_record(void);      // After a tick, stores the game state
+int rewind_step_back(void);    // Restores the newest record and drops it, returns 0 if there is none
+void rewind_reset(void);       // Drops the history, e.g. after the state was loaded from elsewhere
+
+#endif /* REWIND_H */
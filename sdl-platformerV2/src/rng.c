@@ -0,0 +1,32 @@
+#include "rng.h"
+
+// Murmur3 finalizer, spreads nearby seeds (1, 2, 3...) over the whole state space
+static inline Uint32 mix(Uint32 x) {
+    x ^= x >> 16;
+    x *= 0x85ebca6b;
+    x ^= x >> 13;
+    x *= 0xc2b2ae35;
+    x ^= x >> 16;
+    return x;
+}
+
+void rng_seed(Rng* rng, Uint32 seed, Uint32 stream) {
+    rng->state = mix(seed ^ mix(stream + 0x9e3779b9));
+    if (rng->state == 0) {
+        rng->state = 0x9e3779b9; // Xorshift must never be in the zero state
+    }
+}
+
+Uint32 rng_next(Rng* rng) {
+    Uint32 x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return x;
+}
+
+int rng_range(Rng* rng, int n) {
+    // Multiply-shift instead of modulo: no division and no modulo bias
+    return (int)(((Uint64)rng_next(rng) * (Uint32)n) >> 32);
+}
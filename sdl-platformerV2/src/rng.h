@@ -0,0 +1,17 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <SDL2/SDL.h>
+
+// Small xorshift generator. Every level and every dynamic object owns one,
+// so a sequence never depends on how many other objects were updated before.
+typedef struct
+{
+    Uint32 state;
+} Rng;
+
+void rng_seed(Rng* rng, Uint32 seed, Uint32 stream);
+Uint32 rng_next(Rng* rng);
+int rng_range(Rng* rng, int n); // Uniform in [0, n), n must be > 0
+
+#endif /* RNG_H */
@@ -0,0 +1,197 @@
+#include "snapshot.h"
+#include "game.h"
+#include "levels.h"
+#include "helpers.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// World layout, per level in row-major order:
+//   Uint8 cell type ids[ROW_COUNT][COLUMN_COUNT], Rng, int object count,
+//   int index of the player in the objects (-1 if absent), the other objects
+// The player itself is part of the game's own state, not of the world.
+// An object is its Uint8 type id followed by the Object with the type
+// pointer cleared.
+
+// Objects taken from a level while it is restored, reused for the saved ones
+static ObjectArray spare = {NULL, 0, 0};
+
+void snapshot_initialize(Snapshot* snapshot) {
+    snapshot->data = NULL;
+    snapshot->size = 0;
+    snapshot->reserved = 0;
+}
+
+void snapshot_free(Snapshot* snapshot) {
+    free(snapshot->data);
+    snapshot_initialize(snapshot);
+}
+
+void snapshot_clear(Snapshot* snapshot) {
+    snapshot->size = 0;
+}
+
+void snapshot_write(Snapshot* snapshot, const void* data, size_t size) {
+    if (size == 0) {
+        return; // data may be NULL, e.g. the states of a world without any
+    }
+    if (snapshot->size + size > snapshot->reserved) {
+        size_t reserved = snapshot->reserved ? snapshot->reserved : 4096;
+        while (reserved < snapshot->size + size) {
+            reserved *= 2;
+        }
+        snapshot->data = realloc(snapshot->data, reserved);
+        ensure_condition(snapshot->data != NULL, "snapshot_write(): Out of memory");
+        snapshot->reserved = reserved;
+    }
+    memcpy(snapshot->data + snapshot->size, data, size);
+    snapshot->size += size;
+}
+
+void snapshot_read(const Snapshot* snapshot, size_t* offset, void* data, size_t size) {
+    ensure_condition(*offset + size <= snapshot->size, "snapshot_read(): Read past the end of the snapshot");
+    if (size == 0) {
+        return;
+    }
+    memcpy(data, snapshot->data + *offset, size);
+    *offset += size;
+}
+
+static void write_object(Snapshot* snapshot, const Object* object) {
+    const Uint8 typeId = object->type->typeId;
+    Object copy = *object;
+    copy.type = NULL;
+    snapshot_write(snapshot, &typeId, sizeof(typeId));
+    snapshot_write(snapshot, &copy, sizeof(copy));
+}
+
+static void read_object(const Snapshot* snapshot, size_t* offset, Object* object) {
+    Uint8 typeId;
+    snapshot_read(snapshot, offset, &typeId, sizeof(typeId));
+    ensure_condition(typeId < TYPE_COUNT, "snapshot_read(): Invalid object type");
+    snapshot_read(snapshot, offset, object, sizeof(Object));
+    object->type = &objectTypes[typeId];
+}
+
+static void write_level(Snapshot* snapshot, const Level* level) {
+    Uint8 cells[ROW_COUNT][COLUMN_COUNT];
+    for (int r = 0; r < ROW_COUNT; ++r) {
+        for (int c = 0; c < COLUMN_COUNT; ++c) {
+            cells[r][c] = level->cells[r][c]->typeId;
+        }
+    }
+    snapshot_write(snapshot, cells, sizeof(cells));
+    snapshot_write(snapshot, &level->rng, sizeof(level->rng));
+    snapshot_write(snapshot, &level->r, sizeof(level->r));
+    snapshot_write(snapshot, &level->c, sizeof(level->c));
+    snapshot_write(snapshot, &level->initialize, sizeof(level->initialize));
+
+    int playerIndex = -1;
+    for (int i = 0; i < level->objects.count; ++i) {
+        if (level->objects.array[i] == (Object*)&player) {
+            playerIndex = i;
+        }
+    }
+    snapshot_write(snapshot, &level->objects.count, sizeof(level->objects.count));
+    snapshot_write(snapshot, &playerIndex, sizeof(playerIndex));
+    for (int i = 0; i < level->objects.count; ++i) {
+        if (i != playerIndex) {
+            write_object(snapshot, level->objects.array[i]);
+        }
+    }
+}
+
+static void read_level(const Snapshot* snapshot, size_t* offset, Level* level) {
+    Uint8 cells[ROW_COUNT][COLUMN_COUNT];
+    snapshot_read(snapshot, offset, cells, sizeof(cells));
+    for (int r = 0; r < ROW_COUNT; ++r) {
+        for (int c = 0; c < COLUMN_COUNT; ++c) {
+            level->cells[r][c] = &objectTypes[cells[r][c]];
+        }
+    }
+    snapshot_read(snapshot, offset, &level->rng, sizeof(level->rng));
+    snapshot_read(snapshot, offset, &level->r, sizeof(level->r));
+    snapshot_read(snapshot, offset, &level->c, sizeof(level->c));
+    snapshot_read(snapshot, offset, &level->initialize, sizeof(level->initialize));
+
+    int count, playerIndex;
+    snapshot_read(snapshot, offset, &count, sizeof(count));
+    snapshot_read(snapshot, offset, &playerIndex, sizeof(playerIndex));
+
+    if (!spare.array) {
+        ObjectArray_initialize(&spare);
+    }
+    ObjectArray* objects = &level->objects;
+    for (int i = 0; i < objects->count; ++i) {
+        if (objects->array[i] != (Object*)&player) {
+            ObjectArray_append(&spare, objects->array[i]);
+        }
+    }
+
+    objects->count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i == playerIndex) {
+            ObjectArray_append(objects, (Object*)&player);
+            continue;
+        }
+        Object* object;
+        if (spare.count) {
+            object = spare.array[--spare.count];
+        } else {
+            object = malloc(sizeof(Object));
+            ensure_condition(object != NULL, "snapshot_read_world(): Out of memory");
+            allocationCounters.objectsAllocated += 1;
+        }
+        read_object(snapshot, offset, object);
+        ObjectArray_append(objects, object);
+    }
+
+    // The level had more objects than the snapshot
+    while (spare.count) {
+        free(spare.array[--spare.count]);
+        allocationCounters.objectsFreed += 1;
+    }
+}
+
+// Every slot of the room cache is written, free ones as empty rooms, so the
+// rooms return to the slots they were in and pointers to them stay valid
+void snapshot_write_world(Snapshot* snapshot) {
+    snapshot_write(snapshot, &world.useCount, sizeof(world.useCount));
+    snapshot_write(snapshot, world.lastUse, sizeof(world.lastUse));
+    snapshot_write(snapshot, &world.stateCount, sizeof(world.stateCount));
+    snapshot_write(snapshot, world.states, sizeof(RoomState) * world.stateCount);
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i) {
+        write_level(snapshot, &world.rooms[i]);
+    }
+}
+
+void snapshot_read_world(const Snapshot* snapshot, size_t* offset) {
+    snapshot_read(snapshot, offset, &world.useCount, sizeof(world.useCount));
+    snapshot_read(snapshot, offset, world.lastUse, sizeof(world.lastUse));
+    int count;
+    snapshot_read(snapshot, offset, &count, sizeof(count));
+    if (count > world.stateReserved) {
+        world.states = realloc(world.states, sizeof(RoomState) * count);
+        ensure_condition(world.states != NULL, "snapshot_read_world(): Out of memory");
+        world.stateReserved = count;
+    }
+    snapshot_read(snapshot, offset, world.states, sizeof(RoomState) * count);
+    world.stateCount = count;
+    for (int i = 0; i < LEVEL_CACHE_SIZE; ++i) {
+        read_level(snapshot, offset, &world.rooms[i]);
+    }
+}
+
+// The player's own ObjectArray stays as it is, only the Object part and the
+// counters are state
+void snapshot_write_player(Snapshot* snapshot, const Player* player) {
+    write_object(snapshot, (const Object*)player);
+    snapshot_write(snapshot, &player->inAir, offsetof(Player, items) - offsetof(Player, inAir));
+}
+
+void snapshot_read_player(const Snapshot* snapshot, size_t* offset, Player* player) {
+    Object object;
+    read_object(snapshot, offset, &object);
+    memcpy(player, &object, sizeof(object));
+    snapshot_read(snapshot, offset, &player->inAir, offsetof(Player, items) - offsetof(Player, inAir));
+}
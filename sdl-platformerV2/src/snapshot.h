@@ -0,0 +1,35 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "types.h"
+
+// Copy of the simulation state in one contiguous buffer, reused between saves.
+// The world part stores the room cache: the cells of every cached room as type
+// ids, the room's random generator and its objects by value, and the compact
+// state of the evicted rooms. Objects are stored with type ids instead of type
+// pointers and the player by its index in the objects. Restoring overwrites
+// the existing objects instead of allocating new ones, so rollbacks stay
+// cheap. The rooms keep their initialize function pointers, a snapshot is
+// only valid in the program which saved it.
+typedef struct {
+    unsigned char* data;
+    size_t size;
+    size_t reserved;
+} Snapshot;
+
+void snapshot_initialize(Snapshot* snapshot);
+void snapshot_free(Snapshot* snapshot);
+void snapshot_clear(Snapshot* snapshot);
+
+void snapshot_write(Snapshot* snapshot, const void* data, size_t size);
+void snapshot_write_world(Snapshot* snapshot);
+
+// Reading starts at *offset and advances it past the data read
+void snapshot_read(const Snapshot* snapshot, size_t* offset, void* data, size_t size);
+void snapshot_read_world(const Snapshot* snapshot, size_t* offset);
+
+// Everything of the player except its items array
+void snapshot_write_player(Snapshot* snapshot, const Player* player);
+void snapshot_read_player(const Snapshot* snapshot, size_t* offset, Player* player);
+
+#endif /* SNAPSHOT_H */
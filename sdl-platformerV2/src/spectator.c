@@ -0,0 +1,541 @@
+#include "spectator.h"
+#include "game.h"
+#include "spsc_queue.h"
+#include <netdb.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+// Datagram layout, integers big endian:
+//   header: Uint32 magic "PLSP", Uint8 kind, Uint8 message, Uint8 level r, Uint8 level c,
+//           Uint32 tick, Uint32 tick of the frame the delta applies to (0 for keyframes),
+//           Sint16 health, lives, coins, keys
+//   keyframe: Uint8 type count, per type Uint16 sprite x, y, Uint8 w, h,
+//             Uint8 cells[ROW_COUNT][COLUMN_COUNT],
+//             Uint16 object count, per object Uint8 type, frame, flags, alpha, Sint16 x, y
+//   delta: Uint16 changed cells, per cell Uint16 index, Uint8 type,
+//          Uint16 object count, Uint16 changed objects,
+//          per object Uint16 index, Uint8 field mask, the fields in the mask in object order
+static const Uint32 SPECTATOR_MAGIC = 0x504C5350;
+
+enum {
+    KIND_KEYFRAME = 1,
+    KIND_DELTA,
+    HEADER_SIZE = 24,
+    MAX_DATAGRAM = 16384,   // Larger than the largest keyframe and delta
+    QUEUE_SIZE = 4,         // Frames, the game drops frames while the encoder is behind
+    IDLE_TIMEOUT_MS = 100
+};
+
+typedef enum {
+    FIELD_TYPE = 1,
+    FIELD_FRAME = 2,
+    FIELD_FLAGS = 4,
+    FIELD_ALPHA = 8,
+    FIELD_X = 16,
+    FIELD_Y = 32
+} ObjectField;
+
+static struct {
+    pthread_t thread;
+    atomic_int running;
+    sem_t wake;
+    SpscQueue frames;           // Game thread to encoder thread
+    atomic_ulong dropped;
+    int socket;
+    struct sockaddr_storage address;
+    socklen_t address_length;
+    // Game thread
+    Uint32 tick;
+    SpectatorFrame capture;
+    double capture_time;        // Milliseconds, sum
+    double max_capture_time;
+    // Encoder thread
+    SpectatorFrame sent;
+    Uint32 key_tick;
+    Uint8 buffer[MAX_DATAGRAM];
+    unsigned long datagrams;
+    unsigned long keyframes;
+    unsigned long long bytes;
+    double encode_time;         // Milliseconds, sum, including the send
+    double max_encode_time;
+} spectator = {0};
+
+static double get_time_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+static Uint8* put_u8(Uint8* p, int value) {
+    *p = value;
+    return p + 1;
+}
+
+static Uint8* put_u16(Uint8* p, int value) {
+    p[0] = (Uint16)value >> 8;
+    p[1] = (Uint16)value;
+    return p + 2;
+}
+
+static Uint8* put_u32(Uint8* p, Uint32 value) {
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+    return p + 4;
+}
+
+// Bounds checked reading, a read past the end sets ok to 0 and returns 0
+typedef struct {
+    const Uint8* p;
+    const Uint8* end;
+    int ok;
+} Reader;
+
+static unsigned get_u8(Reader* r) {
+    if (r->end - r->p < 1) {
+        r->ok = 0;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static unsigned get_u16(Reader* r) {
+    const unsigned high = get_u8(r);
+    return high << 8 | get_u8(r);
+}
+
+static Uint32 get_u32(Reader* r) {
+    const Uint32 high = get_u16(r);
+    return high << 16 | get_u16(r);
+}
+
+
+// Encoding
+
+static Uint8* encode_header(Uint8* p, int kind, const SpectatorFrame* frame, Uint32 base) {
+    p = put_u32(p, SPECTATOR_MAGIC);
+    p = put_u8(p, kind);
+    p = put_u8(p, frame->message);
+    p = put_u8(p, frame->level_r);
+    p = put_u8(p, frame->level_c);
+    p = put_u32(p, frame->tick);
+    p = put_u32(p, base);
+    p = put_u16(p, frame->health);
+    p = put_u16(p, frame->lives);
+    p = put_u16(p, frame->coins);
+    return put_u16(p, frame->keys);
+}
+
+static size_t encode_keyframe(const SpectatorFrame* frame, Uint8* buffer) {
+    Uint8* p = encode_header(buffer, KIND_KEYFRAME, frame, 0);
+    p = put_u8(p, TYPE_COUNT);
+    for (int i = 0; i < TYPE_COUNT; ++i) {
+        p = put_u16(p, frame->sprites[i].x);
+        p = put_u16(p, frame->sprites[i].y);
+        p = put_u8(p, frame->sprites[i].w);
+        p = put_u8(p, frame->sprites[i].h);
+    }
+    memcpy(p, frame->cells, sizeof(frame->cells));
+    p += sizeof(frame->cells);
+    p = put_u16(p, frame->object_count);
+    for (int i = 0; i < frame->object_count; ++i) {
+        const SpectatorObject* o = &frame->objects[i];
+        p = put_u8(p, o->type);
+        p = put_u8(p, o->frame);
+        p = put_u8(p, o->flags);
+        p = put_u8(p, o->alpha);
+        p = put_u16(p, o->x);
+        p = put_u16(p, o->y);
+    }
+    return p - buffer;
+}
+
+static size_t keyframe_size(const SpectatorFrame* frame) {
+    return HEADER_SIZE + 1 + TYPE_COUNT * 6 + CELL_COUNT + 2 + frame->object_count * 8;
+}
+
+// Returns 0 if the delta would be larger than a keyframe
+static size_t encode_delta(const SpectatorFrame* base, const SpectatorFrame* frame, Uint8* buffer) {
+    const size_t limit = keyframe_size(frame);
+    Uint8* p = encode_header(buffer, KIND_DELTA, frame, base->tick);
+
+    Uint8* count = p;
+    int changed = 0;
+    p += 2;
+    const Uint8* baseCells = &base->cells[0][0];
+    const Uint8* cells = &frame->cells[0][0];
+    for (int i = 0; i < CELL_COUNT; ++i) {
+        if (cells[i] != baseCells[i]) {
+            p = put_u16(p, i);
+            p = put_u8(p, cells[i]);
+            changed += 1;
+        }
+    }
+    put_u16(count, changed);
+    if ((size_t)(p - buffer) > limit) {
+        return 0;
+    }
+
+    p = put_u16(p, frame->object_count);
+    count = p;
+    changed = 0;
+    p += 2;
+    for (int i = 0; i < frame->object_count; ++i) {
+        const SpectatorObject* o = &frame->objects[i];
+        const SpectatorObject* b = &base->objects[i];
+        int mask = FIELD_TYPE | FIELD_FRAME | FIELD_FLAGS | FIELD_ALPHA | FIELD_X | FIELD_Y;
+        if (i < base->object_count) {
+            mask = (o->type != b->type ? FIELD_TYPE : 0) | (o->frame != b->frame ? FIELD_FRAME : 0) |
+                   (o->flags != b->flags ? FIELD_FLAGS : 0) | (o->alpha != b->alpha ? FIELD_ALPHA : 0) |
+                   (o->x != b->x ? FIELD_X : 0) | (o->y != b->y ? FIELD_Y : 0);
+        }
+        if (!mask) {
+            continue;
+        }
+        p = put_u16(p, i);
+        p = put_u8(p, mask);
+        if (mask & FIELD_TYPE) p = put_u8(p, o->type);
+        if (mask & FIELD_FRAME) p = put_u8(p, o->frame);
+        if (mask & FIELD_FLAGS) p = put_u8(p, o->flags);
+        if (mask & FIELD_ALPHA) p = put_u8(p, o->alpha);
+        if (mask & FIELD_X) p = put_u16(p, o->x);
+        if (mask & FIELD_Y) p = put_u16(p, o->y);
+        changed += 1;
+        if ((size_t)(p - buffer) > limit) {
+            return 0;
+        }
+    }
+    put_u16(count, changed);
+    return p - buffer;
+}
+
+static void encode_and_send(const SpectatorFrame* frame) {
+    const double start = get_time_ms();
+
+    size_t size = 0;
+    if (spectator.sent.tick && frame->tick - spectator.key_tick < FRAME_RATE) {
+        size = encode_delta(&spectator.sent, frame, spectator.buffer);
+    }
+    if (!size) {
+        size = encode_keyframe(frame, spectator.buffer);
+        spectator.key_tick = frame->tick;
+        spectator.keyframes += 1;
+    }
+    // Nobody listening is not an error, the viewer may start later
+    sendto(spectator.socket, spectator.buffer, size, MSG_DONTWAIT,
+           (struct sockaddr*)&spectator.address, spectator.address_length);
+
+    // Only the used part of the frame is compared next time
+    spectator.sent.tick = frame->tick;
+    spectator.sent.object_count = frame->object_count;
+    memcpy(spectator.sent.cells, frame->cells, sizeof(frame->cells));
+    memcpy(spectator.sent.objects, frame->objects, sizeof(SpectatorObject) * frame->object_count);
+
+    const double time = get_time_ms() - start;
+    spectator.datagrams += 1;
+    spectator.bytes += size;
+    spectator.encode_time += time;
+    if (time > spectator.max_encode_time) {
+        spectator.max_encode_time = time;
+    }
+}
+
+static void* encoder_thread(void* arg) {
+    (void)arg;
+    static SpectatorFrame frame;
+    while (atomic_load_explicit(&spectator.running, memory_order_acquire)) {
+        struct timespec timeout;
+        clock_gettime(CLOCK_REALTIME, &timeout);
+        timeout.tv_nsec += IDLE_TIMEOUT_MS * 1000000L;
+        if (timeout.tv_nsec >= 1000000000L) {
+            timeout.tv_sec += 1;
+            timeout.tv_nsec -= 1000000000L;
+        }
+        sem_timedwait(&spectator.wake, &timeout);
+        while (spsc_queue_pop(&spectator.frames, &frame)) {
+            encode_and_send(&frame);
+        }
+    }
+    return NULL;
+}
+
+
+// Sockets
+
+static int parse_address(const char* address, struct sockaddr_storage* out, socklen_t* length) {
+    memset(out, 0, sizeof(*out));
+    if (strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un* un = (struct sockaddr_un*)out;
+        if (strlen(address + 5) >= sizeof(un->sun_path)) {
+            fprintf(stderr, "Spectator: Socket path too long: %s\n", address + 5);
+            return 0;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, address + 5);
+        *length = sizeof(*un);
+        return 1;
+    }
+
+    char host[256];
+    const char* colon = strrchr(address, ':');
+    if (!colon || (size_t)(colon - address) >= sizeof(host)) {
+        fprintf(stderr, "Spectator: Expected unix:PATH or HOST:PORT, got %s\n", address);
+        return 0;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    struct addrinfo hints, *info;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_PASSIVE;
+    const int error = getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &info);
+    if (error) {
+        fprintf(stderr, "Spectator: %s: %s\n", address, gai_strerror(error));
+        return 0;
+    }
+    memcpy(out, info->ai_addr, info->ai_addrlen);
+    *length = info->ai_addrlen;
+    freeaddrinfo(info);
+    return 1;
+}
+
+void spectator_start(const char* address) {
+    if (!parse_address(address, &spectator.address, &spectator.address_length)) {
+        return;
+    }
+    spectator.socket = socket(spectator.address.ss_family, SOCK_DGRAM, 0);
+    if (spectator.socket < 0) {
+        perror("Spectator: socket");
+        return;
+    }
+    if (!spsc_queue_init(&spectator.frames, sizeof(SpectatorFrame), QUEUE_SIZE)) {
+        close(spectator.socket);
+        return;
+    }
+    sem_init(&spectator.wake, 0, 0);
+    atomic_store(&spectator.running, 1);
+    if (pthread_create(&spectator.thread, NULL, encoder_thread, NULL) != 0) {
+        atomic_store(&spectator.running, 0);
+        sem_destroy(&spectator.wake);
+        spsc_queue_free(&spectator.frames);
+        close(spectator.socket);
+        return;
+    }
+    printf("Spectator stream to %s\n", address);
+}
+
+void spectator_stop(void) {
+    if (!atomic_load(&spectator.running)) {
+        return;
+    }
+    atomic_store_explicit(&spectator.running, 0, memory_order_release);
+    sem_post(&spectator.wake);
+    pthread_join(spectator.thread, NULL);
+    sem_destroy(&spectator.wake);
+    spsc_queue_free(&spectator.frames);
+    close(spectator.socket);
+
+    const unsigned long n = spectator.datagrams ? spectator.datagrams : 1;
+    printf("Spectator: %lu frames (%lu keyframes, %lu dropped), %.0f bytes per frame\n",
+           spectator.datagrams, spectator.keyframes, atomic_load(&spectator.dropped),
+           (double)spectator.bytes / n);
+    printf("Spectator: capture %.4f ms per tick (max %.4f), encoding %.4f ms per frame (max %.4f)\n",
+           spectator.capture_time / (spectator.tick ? spectator.tick : 1), spectator.max_capture_time,
+           spectator.encode_time / n, spectator.max_encode_time);
+}
+
+void spectator_publish(MessageId message) {
+    if (!atomic_load_explicit(&spectator.running, memory_order_relaxed)) {
+        return;
+    }
+    const double start = get_time_ms();
+
+    SpectatorFrame* frame = &spectator.capture;
+    frame->tick = ++spectator.tick; // Starts at 1, the viewer's empty frame has tick 0
+    frame->message = message == MESSAGE_COUNT ? SPECTATOR_NO_MESSAGE : message;
+    frame->level_r = level->r;
+    frame->level_c = level->c;
+    frame->health = player.health;
+    frame->lives = player.lives;
+    frame->coins = player.coins;
+    frame->keys = player.keys;
+    for (int r = 0; r < ROW_COUNT; ++r) {
+        for (int c = 0; c < COLUMN_COUNT; ++c) {
+            frame->cells[r][c] = level->cells[r][c]->typeId;
+        }
+    }
+    for (int i = 0; i < TYPE_COUNT; ++i) {
+        frame->sprites[i] = objectTypes[i].sprite;
+    }
+    int count = 0;
+    for (int i = 0; i < level->objects.count && count < SPECTATOR_MAX_OBJECTS; ++i) {
+        const Object* object = level->objects.array[i];
+        if (object->removed) {
+            continue;
+        }
+        SpectatorObject* o = &frame->objects[count++];
+        o->type = object->type->typeId;
+        o->frame = object->anim.frame;
+        o->flags = (object->anim.flip & 3) | (object->anim.type & 3) << 2;
+        o->alpha = object->anim.alpha;
+        o->x = object->x;
+        o->y = object->y;
+    }
+    frame->object_count = count;
+
+    if (spsc_queue_push(&spectator.frames, frame)) {
+        sem_post(&spectator.wake);
+    } else {
+        atomic_fetch_add_explicit(&spectator.dropped, 1, memory_order_relaxed);
+    }
+
+    const double time = get_time_ms() - start;
+    spectator.capture_time += time;
+    if (time > spectator.max_capture_time) {
+        spectator.max_capture_time = time;
+    }
+}
+
+
+// Viewer
+
+int spectator_listen(const char* address) {
+    struct sockaddr_storage local;
+    socklen_t length;
+    if (!parse_address(address, &local, &length)) {
+        return -1;
+    }
+    const int s = socket(local.ss_family, SOCK_DGRAM, 0);
+    if (s < 0) {
+        perror("Spectator: socket");
+        return -1;
+    }
+    if (local.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un*)&local)->sun_path); // Left over from an earlier viewer
+    }
+    if (bind(s, (struct sockaddr*)&local, length) < 0) {
+        perror("Spectator: bind");
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static void decode_stats(Reader* r, SpectatorFrame* frame) {
+    frame->health = (Sint16)get_u16(r);
+    frame->lives = (Sint16)get_u16(r);
+    frame->coins = (Sint16)get_u16(r);
+    frame->keys = (Sint16)get_u16(r);
+}
+
+static int decode_keyframe(Reader* r, SpectatorFrame* frame) {
+    const int types = get_u8(r);
+    for (int i = 0; i < types; ++i) {
+        SDL_Rect sprite;
+        sprite.x = get_u16(r);
+        sprite.y = get_u16(r);
+        sprite.w = get_u8(r);
+        sprite.h = get_u8(r);
+        if (i < TYPE_COUNT) {
+            frame->sprites[i] = sprite;
+        }
+    }
+    Uint8* cells = &frame->cells[0][0];
+    for (int i = 0; i < CELL_COUNT; ++i) {
+        cells[i] = get_u8(r);
+    }
+    frame->object_count = get_u16(r);
+    if (frame->object_count > SPECTATOR_MAX_OBJECTS) {
+        return 0;
+    }
+    for (int i = 0; i < frame->object_count; ++i) {
+        SpectatorObject* o = &frame->objects[i];
+        o->type = get_u8(r);
+        o->frame = get_u8(r);
+        o->flags = get_u8(r);
+        o->alpha = get_u8(r);
+        o->x = (Sint16)get_u16(r);
+        o->y = (Sint16)get_u16(r);
+    }
+    return r->ok;
+}
+
+static int decode_delta(Reader* r, SpectatorFrame* frame) {
+    Uint8* cells = &frame->cells[0][0];
+    const int changedCells = get_u16(r);
+    for (int i = 0; i < changedCells && r->ok; ++i) {
+        const unsigned index = get_u16(r);
+        const Uint8 type = get_u8(r);
+        if (index >= CELL_COUNT) {
+            return 0;
+        }
+        cells[index] = type;
+    }
+
+    frame->object_count = get_u16(r);
+    if (frame->object_count > SPECTATOR_MAX_OBJECTS) {
+        return 0;
+    }
+    const int changedObjects = get_u16(r);
+    for (int i = 0; i < changedObjects && r->ok; ++i) {
+        const unsigned index = get_u16(r);
+        const unsigned mask = get_u8(r);
+        if (index >= (unsigned)frame->object_count) {
+            return 0;
+        }
+        SpectatorObject* o = &frame->objects[index];
+        if (mask & FIELD_TYPE) o->type = get_u8(r);
+        if (mask & FIELD_FRAME) o->frame = get_u8(r);
+        if (mask & FIELD_FLAGS) o->flags = get_u8(r);
+        if (mask & FIELD_ALPHA) o->alpha = get_u8(r);
+        if (mask & FIELD_X) o->x = (Sint16)get_u16(r);
+        if (mask & FIELD_Y) o->y = (Sint16)get_u16(r);
+    }
+    return r->ok;
+}
+
+int spectator_decode(const Uint8* data, size_t size, SpectatorFrame* frame) {
+    Reader r = {data, data + size, 1};
+    if (get_u32(&r) != SPECTATOR_MAGIC) {
+        return 0;
+    }
+    const int kind = get_u8(&r);
+    const Uint8 message = get_u8(&r);
+    const Uint8 level_r = get_u8(&r);
+    const Uint8 level_c = get_u8(&r);
+    const Uint32 tick = get_u32(&r);
+    const Uint32 base = get_u32(&r);
+    if (!r.ok || (kind == KIND_DELTA && (base != frame->tick || frame->tick == 0)) ||
+        (kind != KIND_DELTA && kind != KIND_KEYFRAME)) {
+        return 0;
+    }
+
+    decode_stats(&r, frame);
+    const int ok = kind == KIND_KEYFRAME ? decode_keyframe(&r, frame) : decode_delta(&r, frame);
+    for (int i = 0; i < frame->object_count; ++i) {
+        if (frame->objects[i].type >= TYPE_COUNT) {
+            frame->objects[i].type = TYPE_NONE;
+        }
+    }
+    Uint8* cells = &frame->cells[0][0];
+    for (int i = 0; i < CELL_COUNT; ++i) {
+        if (cells[i] >= TYPE_COUNT) {
+            cells[i] = TYPE_NONE;
+        }
+    }
+    // A broken datagram leaves a mix of two frames, wait for the next keyframe
+    frame->tick = ok ? tick : 0;
+    frame->message = message;
+    frame->level_r = level_r;
+    frame->level_c = level_c;
+    return ok;
+}
@@ -0,0 +1,55 @@
+#ifndef SPECTATOR_H
+#define SPECTATOR_H
+
+#include "types.h"
+
+// Spectator stream: after every tick the game thread copies what is visible
+// into a compact frame and queues it. An encoder thread compares the frame
+// with the last one it sent and sends only the changed cells and objects as a
+// datagram. One frame per second is a keyframe, so a viewer which starts
+// late or loses a datagram catches up within a second.
+
+enum {
+    SPECTATOR_MAX_OBJECTS = 1024,   // Visible objects of a room, more aren't streamed
+    SPECTATOR_NO_MESSAGE = 255
+};
+
+// Object as the viewer draws it
+typedef struct {
+    Uint8 type;
+    Uint8 frame;
+    Uint8 flags;    // Bits 0-1: SDL_RendererFlip, bits 2-3: AnimationType
+    Uint8 alpha;
+    Sint16 x;
+    Sint16 y;
+} SpectatorObject;
+
+typedef struct {
+    Uint32 tick;
+    Uint8 message;  // MessageId shown over the level, SPECTATOR_NO_MESSAGE for none
+    Uint8 level_r;
+    Uint8 level_c;
+    Sint16 health;
+    Sint16 lives;
+    Sint16 coins;
+    Sint16 keys;
+    Uint8 cells[ROW_COUNT][COLUMN_COUNT];
+    SDL_Rect sprites[TYPE_COUNT];   // Sprite rects of the types, levels may change them
+    int object_count;
+    SpectatorObject objects[SPECTATOR_MAX_OBJECTS];
+} SpectatorFrame;
+
+// Game side. The address is "unix:PATH" for a local datagram socket or
+// HOST:PORT for UDP. The viewer doesn't have to run, datagrams nobody
+// receives are dropped.
+void spectator_start(const char* address);
+void spectator_stop(void);                  // Prints the encoder statistics
+void spectator_publish(MessageId message);  // Game thread, after a tick, MESSAGE_COUNT for no message
+
+// Viewer side: returns the socket bound to the address, -1 on failure
+int spectator_listen(const char* address);
+// Applies a received datagram to the frame, returns 0 if it doesn't fit, e.g. a
+// delta after a lost datagram. The frame must start zeroed.
+int spectator_decode(const Uint8* data, size_t size, SpectatorFrame* frame);
+
+#endif /* SPECTATOR_H */
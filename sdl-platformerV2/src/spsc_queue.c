@@ -0,0 +1,50 @@
+#include "spsc_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_queue_init(SpscQueue* queue, size_t element_size, size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    queue->buffer = malloc(size * element_size);
+    if (!queue->buffer) {
+        return 0;
+    }
+    queue->element_size = element_size;
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return 1;
+}
+
+void spsc_queue_free(SpscQueue* queue) {
+    free(queue->buffer);
+    queue->buffer = NULL;
+}
+
+int spsc_queue_push(SpscQueue* queue, const void* element) {
+    const size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head > queue->mask) {
+        return 0;
+    }
+    memcpy(queue->buffer + (tail & queue->mask) * queue->element_size, element, queue->element_size);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release); // Publishes the element
+    return 1;
+}
+
+int spsc_queue_pop(SpscQueue* queue, void* element) {
+    const size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) {
+        return 0;
+    }
+    memcpy(element, queue->buffer + (head & queue->mask) * queue->element_size, queue->element_size);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release); // Frees the slot
+    return 1;
+}
+
+size_t spsc_queue_size(SpscQueue* queue) {
+    return atomic_load_explicit(&queue->tail, memory_order_acquire) - atomic_load_explicit(&queue->head, memory_order_acquire);
+}
@@ -0,0 +1,23 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread.
+// Elements are copied in and out by value, the capacity is rounded up to a power of two.
+typedef struct {
+    _Alignas(64) atomic_size_t head; // Next element to pop, written by the consumer only
+    _Alignas(64) atomic_size_t tail; // Next free slot, written by the producer only
+    _Alignas(64) unsigned char* buffer;
+    size_t element_size;
+    size_t mask;
+} SpscQueue;
+
+int spsc_queue_init(SpscQueue* queue, size_t element_size, size_t capacity); // Returns 0 on allocation failure
+void spsc_queue_free(SpscQueue* queue);
+int spsc_queue_push(SpscQueue* queue, const void* element); // Producer side, returns 0 if the queue is full
+int spsc_queue_pop(SpscQueue* queue, void* element);        // Consumer side, returns 0 if the queue is empty
+size_t spsc_queue_size(SpscQueue* queue);                   // Approximate when called concurrently
+
+#endif /* SPSC_QUEUE_H */
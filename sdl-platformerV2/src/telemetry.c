@@ -0,0 +1,144 @@
+#include "telemetry.h"
+#include "game.h"
+#include "input.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { READ_ATTEMPTS = 1000 };
+
+static struct {
+    TelemetryBlock* block;
+    const char* name;
+    TelemetryData data;     // Assembled outside of the write section, which is only a copy
+} telemetry = {0};
+
+void telemetry_start(const char* name) {
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Telemetry: ");
+        perror(name);
+        return;
+    }
+    if (ftruncate(fd, sizeof(TelemetryBlock)) != 0) {
+        perror("Telemetry: ftruncate");
+        close(fd);
+        shm_unlink(name);
+        return;
+    }
+    void* memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        perror("Telemetry: mmap");
+        shm_unlink(name);
+        return;
+    }
+
+    // The header never changes. The magic is written last and readers check it first, so
+    // once they see it the rest of the header is complete
+    TelemetryBlock* block = memory;
+    memset(block, 0, sizeof(*block));
+    block->version = TELEMETRY_VERSION;
+    block->size = sizeof(TelemetryBlock);
+    block->pid = getpid();
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        snprintf(block->phase_names[p], TELEMETRY_NAME_LENGTH, "%s", profiler_get_name(p));
+    }
+    atomic_store_explicit(&block->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    block->magic = TELEMETRY_MAGIC;
+
+    telemetry.block = block;
+    telemetry.name = name;
+    printf("Telemetry in shared memory %s\n", name);
+}
+
+void telemetry_stop(void) {
+    if (!telemetry.block) {
+        return;
+    }
+    munmap(telemetry.block, sizeof(TelemetryBlock));
+    shm_unlink(telemetry.name);
+    telemetry.block = NULL;
+}
+
+void telemetry_publish(void) {
+    if (!telemetry.block) {
+        return;
+    }
+    TelemetryData* data = &telemetry.data;
+    data->frame += 1;
+    data->level_r = level->r;
+    data->level_c = level->c;
+    frame_control_get_stats(&data->frame_stats);
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        data->phase_mean[p] = profiler_get_mean(p);
+        data->phase_max[p] = profiler_get_max(p);
+    }
+    memset(data->objects_per_type, 0, sizeof(data->objects_per_type));
+    for (int i = 0; i < level->objects.count; ++i) {
+        data->objects_per_type[level->objects.array[i]->type->typeId] += 1;
+    }
+    data->object_count = level->objects.count;
+    data->objects_allocated = allocationCounters.objectsAllocated;
+    data->objects_freed = allocationCounters.objectsFreed;
+    data->array_growths = allocationCounters.arrayGrowths;
+    data->input_events = input_get_event_count();
+    data->input_dropped = input_get_dropped_count();
+
+    // Only this thread writes the sequence, so a plain increment is enough
+    TelemetryBlock* block = telemetry.block;
+    const uint32_t sequence = atomic_load_explicit(&block->sequence, memory_order_relaxed);
+    atomic_store_explicit(&block->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&block->data, data, sizeof(*data));
+    atomic_store_explicit(&block->sequence, sequence + 2, memory_order_release);
+}
+
+const TelemetryBlock* telemetry_open(const char* name) {
+    const int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(TelemetryBlock)) {
+        close(fd);
+        return NULL;
+    }
+    void* memory = mmap(NULL, sizeof(TelemetryBlock), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+    const TelemetryBlock* block = memory;
+    const int started = block->magic == TELEMETRY_MAGIC;
+    atomic_thread_fence(memory_order_acquire); // Pairs with the fence before the magic is written
+    if (!started || block->version != TELEMETRY_VERSION || block->size != sizeof(TelemetryBlock)) {
+        munmap(memory, sizeof(TelemetryBlock));
+        return NULL;
+    }
+    return block;
+}
+
+void telemetry_close(const TelemetryBlock* block) {
+    munmap((void*)block, sizeof(TelemetryBlock));
+}
+
+int telemetry_read(const TelemetryBlock* block, TelemetryData* data) {
+    TelemetryBlock* shared = (TelemetryBlock*)block;
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        const uint32_t before = atomic_load_explicit(&shared->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(data, &block->data, sizeof(*data));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&shared->sequence, memory_order_relaxed) == before) {
+            return 1;
+        }
+    }
+    return 0;
+}
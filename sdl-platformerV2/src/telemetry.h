@@ -0,0 +1,62 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "frame_control.h"
+#include "profiler.h"
+#include "types.h"
+#include <stdatomic.h>
+#include <stdint.h>
+
+// Live telemetry: the game maps a shared memory segment (/dev/shm/NAME) at
+// the start and copies its counters into it after every frame. A monitor maps
+// the same segment read-only and copies the counters out. A sequence lock
+// keeps the copies consistent without a lock or a system call on the game
+// thread: the game makes the sequence odd while it writes, a reader retries
+// if the sequence was odd or changed during its copy.
+
+#define TELEMETRY_MAGIC 0x4d4c4554u // "TELM" in little endian
+enum {
+    TELEMETRY_VERSION = 1,
+    TELEMETRY_NAME_LENGTH = 16
+};
+
+typedef struct {
+    uint64_t frame;                 // Frames since the start
+    int32_t level_r;
+    int32_t level_c;
+    FrameStats frame_stats;         // Since the start or the last reset of the pacing statistics
+    double phase_mean[PHASE_COUNT]; // Milliseconds, over the last frames
+    double phase_max[PHASE_COUNT];  // Milliseconds, over the last frames
+    uint32_t object_count;          // Dynamic objects of the current room
+    uint32_t objects_per_type[TYPE_COUNT];
+    uint64_t objects_allocated;
+    uint64_t objects_freed;
+    uint64_t array_growths;         // Reallocations of object arrays
+    uint64_t input_events;          // Button events the game thread received
+    uint64_t input_dropped;         // Button events lost because the queue was full
+} TelemetryData;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;                  // sizeof(TelemetryBlock), readers check it before they trust the layout
+    int32_t pid;                    // Game process, to detect a segment left behind by a crash
+    char phase_names[PHASE_COUNT][TELEMETRY_NAME_LENGTH];
+    _Atomic uint32_t sequence;      // Odd while the game writes the data
+    TelemetryData data;
+} TelemetryBlock;
+
+// Game side. The name is passed to shm_open() and starts with a slash, e.g.
+// "/sdl_platformer". Failing to create the segment only prints a warning.
+void telemetry_start(const char* name);
+void telemetry_stop(void);      // Removes the segment
+void telemetry_publish(void);   // Game thread, after profiler_end_frame()
+
+// Reader side: maps an existing segment, returns NULL if there is none or its
+// layout differs
+const TelemetryBlock* telemetry_open(const char* name);
+void telemetry_close(const TelemetryBlock* block);
+// Copies a consistent state of the data, returns 0 if the writer kept it busy
+int telemetry_read(const TelemetryBlock* block, TelemetryData* data);
+
+#endif /* TELEMETRY_H */
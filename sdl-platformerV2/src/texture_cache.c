@@ -0,0 +1,131 @@
+#include "texture_cache.h"
+#include "helpers.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout, in the byte order of the machine which wrote it:
+//   TextureCacheHeader, TextureCacheEntry[count], the pixels of every image
+//   PIXEL_ALIGNMENT aligned at the offset of its entry
+#define TEXTURE_CACHE_MAGIC "TXCH"
+enum {
+    TEXTURE_CACHE_VERSION = 1,
+    PIXEL_ALIGNMENT = 64
+};
+
+typedef struct {
+    char magic[4];
+    Uint32 version;
+    Uint32 key;
+    Uint32 format;
+    Uint32 count;
+} TextureCacheHeader;
+
+typedef struct {
+    Uint32 width;
+    Uint32 height;
+    Uint32 pitch;
+    Uint32 data;
+    Uint32 offset;
+} TextureCacheEntry;
+
+static struct {
+    void* data;
+    size_t size;
+} mapping;
+
+Uint32 texture_cache_key(const char* const paths[], int count, Uint32 settings) {
+    Uint32 hash = hash_bytes(&settings, sizeof(settings), HASH_INITIAL);
+    for (int i = 0; i < count; ++i) {
+        struct stat info;
+        if (stat(paths[i], &info) != 0) {
+            memset(&info, 0, sizeof(info));
+        }
+        const long long fields[] = {info.st_size, info.st_mtim.tv_sec, info.st_mtim.tv_nsec, info.st_ino};
+        hash = hash_bytes(paths[i], strlen(paths[i]), hash);
+        hash = hash_bytes(fields, sizeof(fields), hash);
+    }
+    return hash;
+}
+
+int texture_cache_load(const char* path, Uint32 key, Uint32 format, CachedImage images[], int count) {
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TextureCacheHeader)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    mapping.data = data;
+    mapping.size = info.st_size;
+
+    const TextureCacheHeader* header = data;
+    const TextureCacheEntry* entries = (const TextureCacheEntry*)(header + 1);
+    if (memcmp(header->magic, TEXTURE_CACHE_MAGIC, 4) != 0 || header->version != TEXTURE_CACHE_VERSION ||
+        header->key != key || header->format != format || header->count != (Uint32)count ||
+        (mapping.size - sizeof(*header)) / sizeof(*entries) < (size_t)count) {
+        texture_cache_close();
+        return 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        const TextureCacheEntry* entry = &entries[i];
+        if (entry->offset > mapping.size || (size_t)entry->pitch * entry->height > mapping.size - entry->offset ||
+            (size_t)entry->width * SDL_BYTESPERPIXEL(format) > entry->pitch) {
+            texture_cache_close();
+            return 0;
+        }
+        images[i] = (CachedImage){entry->width, entry->height, entry->pitch, entry->data,
+                                  (const Uint8*)data + entry->offset};
+    }
+    return 1;
+}
+
+void texture_cache_close(void) {
+    if (mapping.data) {
+        munmap(mapping.data, mapping.size);
+        mapping.data = NULL;
+    }
+}
+
+// Written next to the cache and renamed over it, a game starting meanwhile never maps half a file
+void texture_cache_save(const char* path, Uint32 key, Uint32 format, const CachedImage images[], int count) {
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        fprintf(stderr, "Render cache: ");
+        perror(temporary);
+        return;
+    }
+
+    TextureCacheHeader header = {{'T', 'X', 'C', 'H'}, TEXTURE_CACHE_VERSION, key, format, count};
+    int complete = fwrite(&header, sizeof(header), 1, file) == 1;
+    Uint32 offset = sizeof(header) + sizeof(TextureCacheEntry) * count;
+    for (int i = 0; i < count; ++i) {
+        offset = (offset + PIXEL_ALIGNMENT - 1) / PIXEL_ALIGNMENT * PIXEL_ALIGNMENT;
+        const TextureCacheEntry entry = {images[i].width, images[i].height, images[i].pitch, images[i].data, offset};
+        complete &= fwrite(&entry, sizeof(entry), 1, file) == 1;
+        offset += images[i].pitch * images[i].height;
+    }
+    static const Uint8 PADDING[PIXEL_ALIGNMENT] = {0};
+    for (int i = 0; i < count; ++i) {
+        const long padding = (PIXEL_ALIGNMENT - ftell(file) % PIXEL_ALIGNMENT) % PIXEL_ALIGNMENT;
+        const size_t size = (size_t)images[i].pitch * images[i].height;
+        complete &= fwrite(PADDING, 1, padding, file) == (size_t)padding;
+        complete &= fwrite(images[i].pixels, 1, size, file) == size;
+    }
+
+    if (fclose(file) != 0 || !complete || rename(temporary, path) != 0) {
+        fprintf(stderr, "Render cache: failed to write %s\n", path);
+        remove(temporary);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "types.h"
+
+// Render cache: the images of initializeRender() as the final texture pixels,
+// in the renderer's format, with the colour key already turned into alpha and
+// the texts already rasterized. A warm start maps the file and uploads the
+// pixels, without decoding the BMP, converting it or starting the font
+// renderer. The key hashes the size, modification time and inode of the
+// source files with the settings the images depend on, any change of them
+// makes the game build the images again and replace the cache.
+
+typedef struct {
+    Uint32 width;
+    Uint32 height;
+    Uint32 pitch;
+    Uint32 data;            // Image specific, e.g. the glyph width of a row of glyphs
+    const void* pixels;
+} CachedImage;
+
+Uint32 texture_cache_key(const char* const paths[], int count, Uint32 settings);
+// Returns 1 if the cache has the key and exactly count images, which stay
+// valid until texture_cache_close()
+int texture_cache_load(const char* path, Uint32 key, Uint32 format, CachedImage images[], int count);
+void texture_cache_close(void);
+void texture_cache_save(const char* path, Uint32 key, Uint32 format, const CachedImage images[], int count);
+
+#endif /* TEXTURE_CACHE_H */
@@ -0,0 +1,111 @@
+/**
+ * @file bench.c
+ * @brief Headless benchmark of the game logic.
+ *
+ * Loads level/level1.txt and runs processTick() for a number of ticks with a
+ * fixed frame time and scripted input. Rendering, fonts and GPIO are never
+ * initialized, so only processPlayer() and processObjects() are measured.
+ */
+#include "game.h"
+#include "frame_control.h"
+#include "options.h"
+#include "tool_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Scripted input: runs, jumps and climbs around, space is held all the time
+// so the player respawns immediately after being killed
+static const struct
+{
+    Uint8 input;
+    int ticks;
+} SCRIPT[] = {
+    {INPUT_RIGHT, 96},
+    {INPUT_RIGHT | INPUT_UP, 12},
+    {INPUT_RIGHT, 48},
+    {INPUT_UP, 24},
+    {INPUT_LEFT, 96},
+    {INPUT_LEFT | INPUT_UP, 12},
+    {INPUT_DOWN, 24},
+    {0, 24},
+};
+
+static long long get_time_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int compare_ns(const void* a, const void* b)
+{
+    const long long x = *(const long long*)a;
+    const long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[])
+{
+    long ticks = 100000;
+    options.seed = 1;
+    const ToolOption option_table[] = {
+        {"--ticks", "N", TOOL_LONG, &ticks},
+        {"--seed", "N", TOOL_UNSIGNED, &options.seed},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table) || ticks <= 0) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+
+    initializeSimulation();
+    frame_control_start(FRAME_RATE, MAX_DELTA_TIME);
+    frame_control_set_fixed_frame_time(1000.0 / FRAME_RATE);
+
+    long long* tick_ns = malloc(sizeof(long long) * ticks);
+    long long objects = 0;
+    int step = 0, step_ticks = 0;
+    long done = 0;
+
+    const long long start = get_time_ns();
+    for (; done < ticks && isGameRunning(); ++done) {
+        if (step_ticks == SCRIPT[step].ticks) {
+            step = (step + 1) % (int)SDL_arraysize(SCRIPT);
+            step_ticks = 0;
+        }
+        ++step_ticks;
+        player.lives = 3; // Never game over
+
+        const long long t0 = get_time_ns();
+        processTick(SCRIPT[step].input | INPUT_SPACE);
+        tick_ns[done] = get_time_ns() - t0;
+        objects += level->objects.count - 1; // Without the player
+    }
+    const long long total = get_time_ns() - start;
+
+    if (done < ticks) {
+        printf("Game ended after %ld ticks\n", done);
+    }
+    if (done == 0) {
+        return EXIT_FAILURE;
+    }
+    qsort(tick_ns, done, sizeof(long long), compare_ns);
+
+    long long sum = 0;
+    for (long i = 0; i < done; ++i) {
+        sum += tick_ns[i];
+    }
+    printf("ticks:           %ld (seed %u, %.3f ms per tick)\n", done, options.seed, 1000.0 / FRAME_RATE);
+    printf("ns/tick:         %.0f\n", (double)sum / done);
+    printf("p50:             %lld ns\n", tick_ns[done / 2]);
+    printf("p99:             %lld ns\n", tick_ns[done * 99 / 100]);
+    printf("max:             %lld ns\n", tick_ns[done - 1]);
+    printf("objects/tick:    %.1f\n", (double)objects / done);
+    printf("objects/s:       %.0f\n", objects / (sum / 1e9));
+    printf("wall time:       %.3f s\n", total / 1e9);
+
+    free(tick_ns);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file botserver.c
+ * @brief Headless game for bots, see bot.h for the protocol.
+ *
+ * Runs only the game logic, without window, fonts, audio and GPIO, and
+ * simulates a tick whenever the connected bot steps. Every session is one
+ * process, started with the seed of the session:
+ *     sdl_platformer_botserver --socket /tmp/bot1 --seed 42
+ * The game itself takes a bot with "--bot PATH" and draws what the bot does.
+ */
+#include "bot.h"
+#include "frame_control.h"
+#include "game.h"
+#include "levels.h"
+#include "options.h"
+#include "tool_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char* argv[])
+{
+    const char* path = "/tmp/sdl_platformer_bot";
+    options.seed = 1;
+    const ToolOption option_table[] = {
+        {"--socket", "PATH", TOOL_STRING, &path},
+        {"--seed", "N", TOOL_UNSIGNED, &options.seed},
+        {"--level", "FILE", TOOL_STRING, &levelPath},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table)) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+
+    initializeSimulation();
+    frame_control_start(FRAME_RATE, MAX_DELTA_TIME);
+    frame_control_set_fixed_frame_time(1000.0 / FRAME_RATE);
+    if (!bot_start(path)) {
+        return EXIT_FAILURE; // bot_start() printed the reason
+    }
+
+    int input;
+    while (isGameRunning() && (input = bot_wait_for_step()) >= 0) {
+        processTick(input);
+        bot_step_done();
+    }
+    bot_stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+/**
+ * @file latency_harness.c
+ * @brief Input latency measurement with the simulated GPIO backend.
+ *
+ * Runs the real game loop with the "sim" input backend reading from a pipe.
+ * A writer thread presses and releases left and right with random gaps and
+ * optional contact bounce, then closes the window. The latency module
+ * reports the time from each edge to the tick which simulated it and to the
+ * present which showed it. All other options are passed on to the game,
+ * e.g. --low-latency or --pacing vsync. Rendering uses the dummy video driver
+ * unless SDL_VIDEODRIVER is set.
+ */
+#include "game.h"
+#include "latency.h"
+#include "options.h"
+#include "rng.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const int MIN_GAP = 25; // Milliseconds between two edges, longer than the debounce time
+static const int MAX_GAP = 60;
+
+static struct
+{
+    int presses;
+    int bounces;    // Extra edges 1 ms apart after each press
+    int fd;         // Write end of the pipe
+} harness = {1000, 0, -1};
+
+static double scriptTime = 0; // Milliseconds from the first edge to the last
+
+static void write_edge(double delay, const char* button, const char* action)
+{
+    scriptTime += delay;
+    char line[64];
+    const int length = snprintf(line, sizeof(line), "%.1f %s %s\n", delay, button, action);
+    if (write(harness.fd, line, length) != length) {
+        perror("latency_harness: write");
+    }
+}
+
+static void* writer_thread(void* arg)
+{
+    (void)arg;
+    Rng rng;
+    rng_seed(&rng, options.seed, 0);
+    const long long start = SDL_GetTicks();
+
+    for (int i = 0; i < harness.presses; ++i) {
+        const char* button = i % 2 ? "left" : "right";
+        write_edge(MIN_GAP + rng_range(&rng, MAX_GAP - MIN_GAP), button, "press");
+        for (int b = 0; b < harness.bounces; ++b) {
+            write_edge(1, button, b % 2 ? "press" : "release");
+        }
+        if (harness.bounces % 2) {
+            write_edge(1, button, "press");
+        }
+        write_edge(MIN_GAP + rng_range(&rng, MAX_GAP - MIN_GAP), button, "release");
+    }
+    close(harness.fd);
+
+    // Writing only blocks while the pipe is full, so wait until the script has been played
+    const long long end = start + (long long)scriptTime + 500;
+    while ((long long)SDL_GetTicks() < end) {
+        SDL_Delay(10);
+    }
+
+    SDL_Event quit;
+    SDL_zero(quit);
+    quit.type = SDL_QUIT;
+    SDL_PushEvent(&quit);
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    // Takes the harness options and passes everything else to options_parse()
+    char** gameArgv = malloc(sizeof(char*) * (argc + 3));
+    int gameArgc = 0;
+    gameArgv[gameArgc++] = argv[0];
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--presses") == 0 && i + 1 < argc) {
+            harness.presses = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bounces") == 0 && i + 1 < argc) {
+            harness.bounces = atoi(argv[++i]);
+        } else {
+            gameArgv[gameArgc++] = argv[i];
+        }
+    }
+    if (harness.presses <= 0 || harness.bounces < 0) {
+        fprintf(stderr, "Usage: %s [--presses N] [--bounces N] [game options]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("latency_harness: pipe");
+        return EXIT_FAILURE;
+    }
+    harness.fd = fds[1];
+    char input[32];
+    snprintf(input, sizeof(input), "sim:/dev/fd/%d", fds[0]);
+    gameArgv[gameArgc++] = "--input";
+    gameArgv[gameArgc++] = input;
+    options_parse(gameArgc, gameArgv);
+
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    initializeGame();
+
+    pthread_t writer;
+    pthread_create(&writer, NULL, writer_thread, NULL);
+    handleGameLoop();
+    pthread_join(writer, NULL);
+
+    printf("stage,inputs,mean_ms,p50_ms,p99_ms,max_ms\n");
+    for (int s = 0; s < LATENCY_STAGE_COUNT; ++s) {
+        printf("%s,%lu,%.3f,%.2f,%.2f,%.3f\n", LATENCY_STAGE_NAMES[s], latency_get_count(s), latency_get_mean(s),
+               latency_get_percentile(s, 0.5), latency_get_percentile(s, 0.99), latency_get_max(s));
+    }
+    free(gameArgv);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file levelc.c
+ * @brief Level compiler, turns a text level file into the binary format of level_format.h.
+ *
+ * The game reads both formats. A compiled file is mapped instead of parsed,
+ * so loading it takes the same time for any world size:
+ *     sdl_platformer_levelc level/level1.txt level/level1.lvl
+ *     sdl_platformer --level level/level1.lvl
+ */
+#include "level_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s INPUT.txt OUTPUT.lvl\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* input = fopen(argv[1], "rb");
+    if (!input) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    fseek(input, 0, SEEK_END);
+    const long length = ftell(input);
+    fseek(input, 0, SEEK_SET);
+    char* text = malloc(length);
+    const int complete = text && fread(text, 1, length, input) == (size_t)length;
+    fclose(input);
+    if (!complete) {
+        fprintf(stderr, "Failed to read %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    size_t size;
+    Uint8* data = level_compile(text, length, &size);
+    free(text);
+    if (!data) {
+        return EXIT_FAILURE;
+    }
+
+    // Written next to the output and renamed over it, a game watching the
+    // file (--watch-level) never maps a half written or truncated one
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", argv[2]);
+    FILE* output = fopen(temporary, "wb");
+    if (!output || fwrite(data, 1, size, output) != size || fclose(output) != 0 || rename(temporary, argv[2]) != 0) {
+        perror(argv[2]);
+        remove(temporary);
+        return EXIT_FAILURE;
+    }
+    const LevelFileHeader* header = (const LevelFileHeader*)data;
+    printf("%s: %u x %u rooms, %zu bytes\n", argv[2], header->roomsX, header->roomsY, size);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file levelgen.c
+ * @brief Generator of synthetic stress levels.
+ *
+ * Writes a level file in the regular character format (see levels.c) with a
+ * "#world X Y" header. Every room gets a ground floor, random platforms with
+ * ladders, and enemies, coins, drops and water pools with the given
+ * densities, i.e. the probability per suitable cell.
+ */
+#include "types.h"
+#include "rng.h"
+#include "tool_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct
+{
+    int roomsX, roomsY;
+    double enemies, coins, drops, water;
+    unsigned int seed;
+    const char* output;
+} params = {4, 4, 0.05, 0.10, 0.02, 0.05, 1, NULL};
+
+static Rng rng;
+
+static int chance(double probability)
+{
+    return rng_next(&rng) < probability * 4294967296.0;
+}
+
+static int isSolid(char s)
+{
+    return s == 'x' || s == '*';
+}
+
+static void generateRoom(char room[ROW_COUNT][COLUMN_COUNT], int first, int last)
+{
+    memset(room, ' ', ROW_COUNT * COLUMN_COUNT);
+
+    // Floor with water pools
+    for (int c = 0; c < COLUMN_COUNT; ++c) {
+        room[ROW_COUNT - 1][c] = 'x';
+    }
+    for (int c = 2; c < COLUMN_COUNT - 2; ++c) {
+        if (chance(params.water)) {
+            const int width = 2 + rng_range(&rng, 3);
+            for (int i = 0; i < width && c < COLUMN_COUNT - 2; ++i, ++c) {
+                room[ROW_COUNT - 2][c] = '~';
+            }
+        }
+    }
+
+    // Platforms, each with a ladder down to the next floor
+    for (int r = 3; r < ROW_COUNT - 3; r += 4) {
+        const int length = 3 + rng_range(&rng, 8);
+        const int start = rng_range(&rng, COLUMN_COUNT - length);
+        for (int c = start; c < start + length; ++c) {
+            room[r][c] = 'x';
+        }
+        const int ladder = start + rng_range(&rng, length);
+        for (int rr = r; rr < ROW_COUNT - 1 && !isSolid(room[rr + 1][ladder]); ++rr) {
+            if (room[rr + 1][ladder] == '~') {
+                break;
+            }
+            room[rr][ladder] = '=';
+        }
+    }
+
+    // Objects
+    static const char WALKERS[] = "srqepg";
+    for (int r = 1; r < ROW_COUNT - 1; ++r) {
+        for (int c = 0; c < COLUMN_COUNT; ++c) {
+            if (room[r][c] != ' ') {
+                continue;
+            }
+            if (isSolid(room[r + 1][c]) && chance(params.enemies)) {
+                room[r][c] = WALKERS[rng_range(&rng, sizeof(WALKERS) - 1)];
+            } else if (isSolid(room[r - 1][c]) && chance(params.drops)) {
+                room[r][c] = '`';
+            } else if (chance(params.enemies / 4)) {
+                room[r][c] = rng_range(&rng, 2) ? 'b' : 'f';
+            } else if (chance(params.coins)) {
+                room[r][c] = 'o';
+            }
+        }
+    }
+
+    if (first) {
+        room[ROW_COUNT - 2][1] = 'P';
+        room[ROW_COUNT - 2][0] = ' ';
+        room[ROW_COUNT - 2][2] = ' ';
+    }
+    if (last) {
+        room[ROW_COUNT - 2][COLUMN_COUNT - 2] = 'S';
+    }
+}
+
+static double clampDensity(double density)
+{
+    return density < 0 ? 0 : density > 1 ? 1 : density;
+}
+
+int main(int argc, char* argv[])
+{
+    const ToolOption option_table[] = {
+        {"--rooms-x", "N", TOOL_INT, &params.roomsX},
+        {"--rooms-y", "N", TOOL_INT, &params.roomsY},
+        {"--enemies", "D", TOOL_DOUBLE, &params.enemies},
+        {"--coins", "D", TOOL_DOUBLE, &params.coins},
+        {"--drops", "D", TOOL_DOUBLE, &params.drops},
+        {"--water", "D", TOOL_DOUBLE, &params.water},
+        {"--seed", "N", TOOL_UNSIGNED, &params.seed},
+        {"--output", "FILE", TOOL_STRING, &params.output},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table) || params.roomsX <= 0 || params.roomsY <= 0) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+    params.enemies = clampDensity(params.enemies);
+    params.coins = clampDensity(params.coins);
+    params.drops = clampDensity(params.drops);
+    params.water = clampDensity(params.water);
+
+    FILE* file = params.output ? fopen(params.output, "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "Unable to create file %s\n", params.output);
+        return EXIT_FAILURE;
+    }
+    rng_seed(&rng, params.seed, 0);
+
+    // The level format is row by row over the whole world, so one row of rooms is generated at a time
+    char (*rooms)[ROW_COUNT][COLUMN_COUNT] = malloc(sizeof(*rooms) * params.roomsX);
+    fprintf(file, "#world %d %d\n", params.roomsX, params.roomsY);
+    for (int lr = 0; lr < params.roomsY; ++lr) {
+        for (int lc = 0; lc < params.roomsX; ++lc) {
+            const int first = lr == 0 && lc == 0;
+            const int last = lr == params.roomsY - 1 && lc == params.roomsX - 1;
+            generateRoom(rooms[lc], first, last && !first);
+        }
+        for (int r = 0; r < ROW_COUNT; ++r) {
+            for (int lc = 0; lc < params.roomsX; ++lc) {
+                fwrite(rooms[lc][r], 1, COLUMN_COUNT, file);
+            }
+            fputc('\n', file);
+        }
+    }
+
+    free(rooms);
+    if (file != stdout) {
+        fclose(file);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/**
+ * @file nettest.c
+ * @brief Loopback test of the rollback versus mode.
+ *
+ * Forks a host and a client which connect over UDP on 127.0.0.1 and play a
+ * headless versus match with random input for a number of ticks. Outgoing
+ * packets are dropped on purpose, so both sides mispredict, roll back and
+ * simulate again. Each side compares the checksums of the confirmed ticks with
+ * its peer's and fails on the first desync. The test passes if both sides
+ * compared checksums and found no difference.
+ */
+#include "game.h"
+#include "frame_control.h"
+#include "net.h"
+#include "options.h"
+#include "rng.h"
+#include "tool_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int LINGER_FRAMES = 200; // Keep sending after the last tick until the peer is done, too
+static const int FRAME_US = 1000;     // Runs faster than real time, the peers wait for each other
+
+static struct
+{
+    int ticks;
+    int port;
+    int loss;
+    int delay;
+} test = {2000, 47600, 10, 1};
+
+// Changes the held buttons every few ticks, space respawns after being killed
+static Uint8 random_input(Rng* rng, int tick, Uint8 input)
+{
+    static const Uint8 MOVES[] = {
+        0, INPUT_LEFT, INPUT_RIGHT, INPUT_LEFT | INPUT_UP, INPUT_RIGHT | INPUT_UP, INPUT_UP, INPUT_DOWN, INPUT_SPACE,
+    };
+    if (tick % 8 == 0) {
+        input = MOVES[rng_range(rng, SDL_arraysize(MOVES))];
+    }
+    return input;
+}
+
+static int run_side(int slot)
+{
+    Uint32 seed = options.seed;
+    net_set_packet_loss(test.loss);
+    char address[32];
+    snprintf(address, sizeof(address), "127.0.0.1:%d", test.port);
+    if (!(slot == 0 ? net_host(test.port, &seed) : net_join(address, &seed))) {
+        return EXIT_FAILURE;
+    }
+    options.seed = seed;
+    options.net_delay = test.delay;
+
+    initializeSimulation();
+    frame_control_start(FRAME_RATE, MAX_DELTA_TIME);
+    initializeVersus();
+
+    Rng rng;
+    rng_seed(&rng, seed, 100 + slot);
+    Uint8 input = 0;
+    int linger = 0;
+    while (linger < LINGER_FRAMES && !net_peer_left()) {
+        if (getVersusTick() >= test.ticks && net_get_confirmed_tick() >= test.ticks) {
+            linger += 1;
+        }
+        input = random_input(&rng, getVersusTick(), input);
+        processVersusFrame(input);
+        usleep(FRAME_US);
+    }
+
+    NetStats stats;
+    net_get_stats(&stats);
+    printf("Slot %d: %d ticks\n", slot, getVersusTick());
+    net_print_stats();
+    net_shutdown();
+    return stats.desync_tick < 0 && stats.checksums_compared > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[])
+{
+    options.seed = 1;
+    const ToolOption option_table[] = {
+        {"--ticks", "N", TOOL_INT, &test.ticks},
+        {"--port", "N", TOOL_INT, &test.port},
+        {"--loss", "PERCENT", TOOL_INT, &test.loss},
+        {"--delay", "TICKS", TOOL_INT, &test.delay},
+        {"--seed", "N", TOOL_UNSIGNED, &options.seed},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table) || test.ticks <= 0 || test.delay < 0 || test.delay > NET_MAX_DELAY) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+
+    fflush(stdout);
+    pid_t pids[NET_PLAYER_COUNT];
+    for (int slot = 0; slot < NET_PLAYER_COUNT; ++slot) {
+        pids[slot] = fork();
+        if (pids[slot] < 0) {
+            perror("nettest: fork");
+            return EXIT_FAILURE;
+        }
+        if (pids[slot] == 0) {
+            exit(run_side(slot));
+        }
+    }
+
+    int passed = 1;
+    for (int slot = 0; slot < NET_PLAYER_COUNT; ++slot) {
+        int status;
+        waitpid(pids[slot], &status, 0);
+        passed &= WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+    }
+    printf("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
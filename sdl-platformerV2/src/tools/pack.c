@@ -0,0 +1,93 @@
+/**
+ * @file pack.c
+ * @brief Writes the asset pack of asset_pack.h.
+ *
+ * Every file is stored under the path it is given with, which must be the
+ * name the game asks for, so it runs from src/:
+ *     sdl_platformer_pack assets.pack image/sprites.bmp font/PressStart2P.ttf level/level1.lvl
+ * "make pack" packs all assets of the game.
+ */
+#include "asset_pack.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Reads the whole file, returns NULL after printing the reason
+static Uint8* read_file(const char* path, long* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    Uint8* data = malloc(*size > 0 ? *size : 1);
+    const int complete = data && fread(data, 1, *size, file) == (size_t)*size;
+    fclose(file);
+    if (!complete) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s OUTPUT.pack FILE...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const int count = argc - 2;
+    const char** names = (const char**)argv + 2;
+    qsort(names, count, sizeof(*names), compare_names); // The game searches the entries by name
+    for (int i = 0; i < count; ++i) {
+        if (strlen(names[i]) >= ASSET_NAME_SIZE || (i > 0 && strcmp(names[i - 1], names[i]) == 0)) {
+            fprintf(stderr, "%s: name too long or given twice\n", names[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    AssetPackEntry* entries = calloc(count, sizeof(AssetPackEntry));
+    Uint8** data = calloc(count, sizeof(Uint8*));
+    Uint32 offset = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * count;
+    for (int i = 0; i < count; ++i) {
+        long size;
+        if (!(data[i] = read_file(names[i], &size))) {
+            return EXIT_FAILURE;
+        }
+        offset = (offset + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+        strcpy(entries[i].name, names[i]);
+        entries[i].offset = offset;
+        entries[i].size = size;
+        offset += size;
+    }
+
+    // Written next to the output and renamed over it, a running game keeps its mapping intact
+    char temporary[4096];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", argv[1]);
+    FILE* output = fopen(temporary, "wb");
+    const AssetPackHeader header = {{'P', 'A', 'C', 'K'}, ASSET_PACK_VERSION, count, offset};
+    int complete = output && fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(entries, sizeof(AssetPackEntry), count, output) == (size_t)count;
+    static const Uint8 PADDING[ASSET_PACK_ALIGNMENT] = {0};
+    for (int i = 0; complete && i < count; ++i) {
+        const long padding = entries[i].offset - ftell(output);
+        complete = fwrite(PADDING, 1, padding, output) == (size_t)padding &&
+                   fwrite(data[i], 1, entries[i].size, output) == entries[i].size;
+        free(data[i]);
+    }
+    if (!output || fclose(output) != 0 || !complete || rename(temporary, argv[1]) != 0) {
+        perror(argv[1]);
+        remove(temporary);
+        return EXIT_FAILURE;
+    }
+    printf("%s: %d files, %u bytes\n", argv[1], count, offset);
+    free(entries);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file sweep.c
+ * @brief Scaling sweep of simulation, rendering and cleanup cost.
+ *
+ * Loads a level (e.g. one written by sdl_platformer_levelgen), fills the
+ * start room up to a given number of objects and measures per frame the
+ * time of processTick(), of drawScreen() plus SDL_RenderPresent() and of
+ * ObjectArray_clean(). One CSV line is printed per object count. Rendering
+ * uses the dummy video driver unless SDL_VIDEODRIVER is set.
+ */
+#include "game.h"
+#include "levels.h"
+#include "render.h"
+#include "frame_control.h"
+#include "options.h"
+#include "tool_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const ObjectTypeId OBJECT_MIX[] = {
+    TYPE_COIN, TYPE_COIN, TYPE_RAT, TYPE_SCORPION, TYPE_BLOB, TYPE_SPIDER,
+    TYPE_BAT, TYPE_FIREBALL, TYPE_DROP, TYPE_WATER_TOP
+};
+
+typedef struct
+{
+    double* samples;
+    int count;
+} Samples;
+
+static long long get_time_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double mean(const Samples* s)
+{
+    double sum = 0;
+    for (int i = 0; i < s->count; ++i) {
+        sum += s->samples[i];
+    }
+    return sum / s->count;
+}
+
+static double percentile(Samples* s, int p)
+{
+    qsort(s->samples, s->count, sizeof(double), compare_double);
+    return s->samples[s->count * p / 100];
+}
+
+// Adds objects at random cells of the current room until it holds count objects
+static void populate(int count, Rng* rng)
+{
+    while (level->objects.count - 1 < count) {
+        const ObjectTypeId type = OBJECT_MIX[rng_range(rng, SDL_arraysize(OBJECT_MIX))];
+        createDynamicObject(level, type, rng_range(rng, ROW_COUNT - 1), rng_range(rng, COLUMN_COUNT));
+    }
+    ObjectArray_sortByDepth(&level->objects);
+}
+
+int main(int argc, char* argv[])
+{
+    int ticks = 200;
+    const char* count_list = "10,100,1000,10000,100000";
+    options.seed = 1;
+    const ToolOption option_table[] = {
+        {"--level", "FILE", TOOL_STRING, &levelPath},
+        {"--ticks", "N", TOOL_INT, &ticks},
+        {"--counts", "N,N,...", TOOL_STRING, &count_list},
+        {"--seed", "N", TOOL_UNSIGNED, &options.seed},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table) || ticks <= 0) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+    char counts[256];
+    snprintf(counts, sizeof(counts), "%s", count_list);
+
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    initializeRender("image/sprites.bmp", "font/PressStart2P.ttf", NULL, 0);
+    frame_control_start(FRAME_RATE, MAX_DELTA_TIME);
+    frame_control_set_fixed_frame_time(1000.0 / FRAME_RATE);
+
+    Samples sim = {malloc(sizeof(double) * ticks), ticks};
+    Samples draw = {malloc(sizeof(double) * ticks), ticks};
+    Samples clean = {malloc(sizeof(double) * ticks), ticks};
+
+    printf("objects,sim_ms,sim_p99_ms,render_ms,render_p99_ms,clean_ms,clean_p99_ms\n");
+    for (char* token = strtok(counts, ","); token; token = strtok(NULL, ",")) {
+        const int count = atoi(token);
+        Rng rng;
+        rng_seed(&rng, options.seed, count);
+
+        initializeSimulation();
+        populate(count, &rng);
+
+        for (int t = 0; t < ticks; ++t) {
+            // Keep the player alive. It gets no movement input, so it stays in the start room
+            player.lives = 3;
+            player.invincibility = 1000;
+
+            long long t0 = get_time_ns();
+            processTick(INPUT_SPACE);
+            sim.samples[t] = (get_time_ns() - t0) / 1e6;
+
+            t0 = get_time_ns();
+            SDL_RenderClear(renderer);
+            drawScreen();
+            SDL_RenderPresent(renderer);
+            draw.samples[t] = (get_time_ns() - t0) / 1e6;
+
+            t0 = get_time_ns();
+            ObjectArray_clean(&level->objects);
+            clean.samples[t] = (get_time_ns() - t0) / 1e6;
+        }
+
+        printf("%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", level->objects.count - 1,
+               mean(&sim), percentile(&sim, 99), mean(&draw), percentile(&draw, 99),
+               mean(&clean), percentile(&clean, 99));
+        fflush(stdout);
+
+        ObjectArray_free(&player.items);
+        freeLevels();
+    }
+
+    free(sim.samples);
+    free(draw.samples);
+    free(clean.samples);
+    return EXIT_SUCCESS;
+}
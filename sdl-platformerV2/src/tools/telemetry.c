@@ -0,0 +1,86 @@
+/**
+ * @file telemetry.c
+ * @brief Prints the live telemetry of a game started with "--telemetry NAME".
+ *
+ * Maps the shared memory segment read-only and prints one consistent copy of
+ * the counters, or a new one every few seconds with "--watch SEC". The game
+ * doesn't notice the reader, several of them can watch the same game.
+ */
+#include "telemetry.h"
+#include "tool_options.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void print_data(const TelemetryBlock* block, const TelemetryData* data, const TelemetryData* last, double seconds)
+{
+    const FrameStats* stats = &data->frame_stats;
+    printf("Frame %llu, room %d,%d, process %d\n", (unsigned long long)data->frame, data->level_r, data->level_c, block->pid);
+    if (last) {
+        printf("  %.1f frames per second since the last update\n", (data->frame - last->frame) / seconds);
+    }
+    printf("  Interval: mean %.2f ms, jitter %.2f ms, min %.2f ms, max %.2f ms over %lu frames\n",
+           stats->mean_interval, stats->jitter, stats->min_interval, stats->max_interval, stats->frames);
+    printf("  Missed deadlines: %lu (max %.2f ms late)\n", stats->missed_deadlines, stats->max_lateness);
+    printf("  Phases (mean/max ms):");
+    for (int p = 0; p < PHASE_COUNT; ++p) {
+        printf(" %s %.3f/%.3f", block->phase_names[p], data->phase_mean[p], data->phase_max[p]);
+    }
+    printf("\n  Objects: %u in the room, by type id:", data->object_count);
+    for (int t = 0; t < TYPE_COUNT; ++t) {
+        if (data->objects_per_type[t]) {
+            printf(" %d:%u", t, data->objects_per_type[t]);
+        }
+    }
+    printf("\n  Allocations: %llu objects allocated, %llu freed, %llu array growths\n",
+           (unsigned long long)data->objects_allocated, (unsigned long long)data->objects_freed,
+           (unsigned long long)data->array_growths);
+    printf("  Input: %llu events, %llu dropped\n",
+           (unsigned long long)data->input_events, (unsigned long long)data->input_dropped);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* name = "/sdl_platformer";
+    double watch = 0;
+    const ToolOption option_table[] = {
+        {"--name", "NAME", TOOL_STRING, &name},
+        {"--watch", "SEC", TOOL_DOUBLE, &watch},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table)) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+
+    const TelemetryBlock* block = telemetry_open(name);
+    if (!block) {
+        fprintf(stderr, "No telemetry in %s, is the game running with --telemetry %s?\n", name, name);
+        return EXIT_FAILURE;
+    }
+
+    TelemetryData data, last;
+    int have_last = 0;
+    do {
+        if (have_last) {
+            usleep(watch * 1e6);
+        }
+        if (kill(block->pid, 0) != 0) {
+            fprintf(stderr, "The game (process %d) has ended\n", block->pid);
+            break;
+        }
+        if (!telemetry_read(block, &data)) {
+            fprintf(stderr, "The game kept the telemetry busy, try again\n");
+            continue;
+        }
+        print_data(block, &data, have_last ? &last : NULL, watch);
+        last = data;
+        have_last = 1;
+    } while (watch > 0);
+
+    telemetry_close(block);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file tool_options.h
+ * @brief Option parsing of the tools in tools/.
+ *
+ * The tools only take "--name VALUE" pairs. Each lists its options in a
+ * table ending with {NULL}, which is both the parser and the usage line:
+ *     const ToolOption option_table[] = {
+ *         {"--ticks", "N", TOOL_LONG, &ticks},
+ *         {NULL}
+ *     };
+ * An unknown option or one without a value fails the parse, the tool then
+ * prints the usage instead of running with its defaults after a typo.
+ */
+#ifndef TOOL_OPTIONS_H
+#define TOOL_OPTIONS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    TOOL_STRING,    // const char*
+    TOOL_INT,       // int
+    TOOL_LONG,      // long
+    TOOL_UNSIGNED,  // unsigned int
+    TOOL_DOUBLE     // double
+} ToolOptionType;
+
+typedef struct {
+    const char* name;       // With the dashes, e.g. "--ticks"
+    const char* value_name; // Shown in the usage, e.g. "N"
+    ToolOptionType type;
+    void* value;            // Variable of the type
+} ToolOption;
+
+static inline void tool_print_usage(const char* program, const ToolOption* table) {
+    fprintf(stderr, "Usage: %s", program);
+    for (; table->name; ++table) {
+        fprintf(stderr, " [%s %s]", table->name, table->value_name);
+    }
+    fprintf(stderr, "\n");
+}
+
+// Stores the values of the options in their variables. Returns 0 if an option
+// is unknown or has no value.
+static inline int tool_parse_options(int argc, char* argv[], const ToolOption* table) {
+    for (int i = 1; i < argc; i += 2) {
+        const ToolOption* option = table;
+        while (option->name && strcmp(option->name, argv[i]) != 0) {
+            ++option;
+        }
+        if (!option->name || i + 1 >= argc) {
+            return 0;
+        }
+        const char* value = argv[i + 1];
+        switch (option->type) {
+            case TOOL_STRING:
+                *(const char**)option->value = value;
+                break;
+            case TOOL_INT:
+                *(int*)option->value = strtol(value, NULL, 0);
+                break;
+            case TOOL_LONG:
+                *(long*)option->value = strtol(value, NULL, 0);
+                break;
+            case TOOL_UNSIGNED:
+                *(unsigned int*)option->value = strtoul(value, NULL, 0);
+                break;
+            case TOOL_DOUBLE:
+                *(double*)option->value = strtod(value, NULL);
+                break;
+        }
+    }
+    return 1;
+}
+
+#endif /* TOOL_OPTIONS_H */
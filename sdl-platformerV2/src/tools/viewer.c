@@ -0,0 +1,125 @@
+/**
+ * @file viewer.c
+ * @brief Spectator viewer for the stream of "--spectate ADDRESS".
+ *
+ * Receives the keyframes and deltas of a running game and draws them with
+ * render.c, together with the player's stats. The game doesn't have to run
+ * yet, the viewer shows the first keyframe it receives.
+ */
+#include "game.h"
+#include "render.h"
+#include "spectator.h"
+#include "tool_options.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+static const int FRAME_MS = 16;
+
+static SpectatorFrame frame;
+static Object objects[SPECTATOR_MAX_OBJECTS];
+static Object* objectPointers[SPECTATOR_MAX_OBJECTS];
+static Level view;
+
+// Turns the received frame into a level render.c can draw
+static void buildLevel()
+{
+    for (int i = 0; i < TYPE_COUNT; ++i) {
+        objectTypes[i].sprite = frame.sprites[i];
+    }
+    for (int r = 0; r < ROW_COUNT; ++r) {
+        for (int c = 0; c < COLUMN_COUNT; ++c) {
+            view.cells[r][c] = &objectTypes[frame.cells[r][c]];
+        }
+    }
+    for (int i = 0; i < frame.object_count; ++i) {
+        const SpectatorObject* o = &frame.objects[i];
+        Object* object = &objects[i];
+        object->type = &objectTypes[o->type];
+        object->x = o->x;
+        object->y = o->y;
+        object->removed = 0;
+        object->anim.frame = o->frame;
+        object->anim.flip = o->flags & 3;
+        object->anim.type = o->flags >> 2 & 3;
+        object->anim.alpha = o->alpha;
+        objectPointers[i] = object;
+    }
+    view.objects.array = objectPointers;
+    view.objects.count = frame.object_count;
+    view.r = frame.level_r;
+    view.c = frame.level_c;
+}
+
+static void drawStats()
+{
+    char line[96];
+    if (!frame.tick) {
+        snprintf(line, sizeof(line), "Waiting for the game");
+    } else {
+        snprintf(line, sizeof(line), "Room %d,%d  Lives %d  Health %d  Coins %d  Keys %d",
+                 frame.level_r, frame.level_c, frame.lives, frame.health, frame.coins, frame.keys);
+    }
+    drawOverlayBox(0, 0, (strlen(line) + 1) * OVERLAY_FONT_SIZE, OVERLAY_FONT_SIZE + 6);
+    drawText(line, 4, 3);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* address = "unix:/tmp/sdl_platformer_spectator";
+    const ToolOption option_table[] = {
+        {"--listen", "unix:PATH|HOST:PORT", TOOL_STRING, &address},
+        {NULL}
+    };
+    if (!tool_parse_options(argc, argv, option_table)) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+    const int s = spectator_listen(address);
+    if (s < 0) {
+        tool_print_usage(argv[0], option_table);
+        return EXIT_FAILURE;
+    }
+    printf("Listening on %s\n", address);
+
+    initializeTypes();
+    initializeRender("image/sprites.bmp", "font/PressStart2P.ttf", "render.cache", 1);
+
+    unsigned long received = 0, rejected = 0;
+    static Uint8 datagram[65536];
+    int running = 1;
+    while (running) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                running = 0;
+            }
+        }
+
+        struct pollfd fd = {s, POLLIN, 0};
+        poll(&fd, 1, FRAME_MS);
+        ssize_t size;
+        while ((size = recv(s, datagram, sizeof(datagram), MSG_DONTWAIT)) > 0) {
+            received += 1;
+            rejected += !spectator_decode(datagram, size, &frame);
+        }
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        if (frame.tick) {
+            buildLevel();
+            drawLevel(&view);
+            if (frame.message < MESSAGE_COUNT) {
+                drawMessage(frame.message);
+            }
+        }
+        drawStats();
+        SDL_RenderPresent(renderer);
+    }
+
+    printf("Viewer: %lu datagrams, %lu waited for a keyframe\n", received, rejected);
+    SDL_Quit();
+    return EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@ const double MAX_DELTA_TIME = 1000.0 / MIN_FRAME_RATE;
 const double MAX_SPEED = MIN_FRAME_RATE * CELL_SIZE;
 
 ObjectType objectTypes[TYPE_COUNT];
+AllocationCounters allocationCounters = {0};
 
 
 // ObjectArray
@@ -23,6 +24,7 @@ void ObjectArray_append( ObjectArray* objects, Object* object )
     if (objects->count == objects->reserved) {
         objects->reserved *= 2;
         objects->array = (Object**)realloc(objects->array, sizeof(Object*) * objects->reserved);
+        allocationCounters.arrayGrowths += 1;
     }
     objects->array[objects->count ++] = object;
 }
@@ -42,6 +44,7 @@ void ObjectArray_clean( ObjectArray* objects )
         Object* object = objects->array[i];
         if (object->removed == 1) {
             free(object);
+            allocationCounters.objectsFreed += 1;
             r += 1;
         } else if (object->removed == 2) {
             r += 1;
@@ -73,6 +76,8 @@ void createStaticObject( Level* level, ObjectTypeId typeId, int r, int c )
 Object* createDynamicObject( Level* level, ObjectTypeId typeId, int r, int c )
 {
     Object* object = (Object*)malloc(sizeof(Object));
+    allocationCounters.objectsAllocated += 1;
+    rng_seed(&object->rng, rng_next(&level->rng), 0);
     initializeObject(object, typeId);
     object->x = CELL_SIZE * c;
     object->y = CELL_SIZE * r;
@@ -90,6 +95,7 @@ void initializeObject( Object* object, ObjectTypeId typeId )
     object->removed = 0;
     object->state = 0;
     object->data = 0;
+    object->origin = -1;
     object->anim.flip = SDL_FLIP_NONE;
     object->anim.frameDelayCounter = 0;
     object->anim.type = ANIMATION_FRAME;
@@ -100,6 +106,7 @@ void initializeObject( Object* object, ObjectTypeId typeId )
 
 void initializePlayer( Player* player )
 {
+    rng_seed(&player->rng, 0, 0);
     initializeObject((Object*)player, TYPE_PLAYER);
     player->inAir = 0;
     player->onLadder = 0;
@@ -2,6 +2,7 @@
 #define TYPES_H
 
 #include <SDL2/SDL.h>
+#include "rng.h"
 
 
 //#define DEBUG_MODE
@@ -169,6 +170,8 @@ typedef struct Object_s
     int removed;
     int state;
     int data;
+    Rng rng;        // Seeded from the level's generator on creation
+    int origin;     // Cell index the level file placed the object at, -1 if the game created it
 } Object;
 
 typedef struct
@@ -190,6 +193,8 @@ typedef struct
     int removed;        // Unused
     int state;          // Unused
     int data;           // Unused
+    Rng rng;            // Unused
+    int origin;         // Unused
     int inAir;
     int onLadder;
     int health;
@@ -204,11 +209,20 @@ typedef struct
 {
     ObjectType* cells[ROW_COUNT][COLUMN_COUNT];
     ObjectArray objects;
+    Rng rng;
     int r;
     int c;
     void (*initialize)();
 } Level;
 
+// Heap operations on objects since the start, read by the telemetry
+typedef struct
+{
+    unsigned long objectsAllocated;
+    unsigned long objectsFreed;
+    unsigned long arrayGrowths;
+} AllocationCounters;
+
 void ObjectArray_initialize( ObjectArray* objects );
 void ObjectArray_append( ObjectArray* objects, Object* object );
 void ObjectArray_free( ObjectArray* objects );
@@ -223,5 +237,6 @@ void initializeLevel( Level* level );
 void initializeTypes();
 
 extern ObjectType objectTypes[TYPE_COUNT];
+extern AllocationCounters allocationCounters;
 
 #endif
\ No newline at end of file